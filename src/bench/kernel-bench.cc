@@ -0,0 +1,642 @@
+#include <getopt.h>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <memory>
+#include <functional>
+
+#include "ivf.hh"
+#include "player.hh"
+#include "uncompressed_chunk.hh"
+#include "decoder_state.hh"
+#include "tokens.hh"
+#include "quantization.hh"
+#include "loopfilter.hh"
+#include "bool_encoder.hh"
+#include "encoder.hh"
+#include "temp_file.hh"
+
+using namespace std;
+
+/* reaches the encoder's private kernels */
+class KernelBench
+{
+public:
+  template <unsigned int size>
+  static uint32_t sse( const VP8Raster::Block<size> & block,
+                       const TwoDSubRange<uint8_t, size, size> & prediction )
+  {
+    return Encoder::sse( block, prediction );
+  }
+
+  template <unsigned int size>
+  static uint32_t variance( const VP8Raster::Block<size> & block,
+                            const TwoDSubRange<uint8_t, size, size> & prediction )
+  {
+    return Encoder::variance( block, prediction );
+  }
+
+  static void trellis_quantize( const Encoder & encoder, YBlock & block, const Quantizer & quantizer )
+  {
+    encoder.trellis_quantize( block, quantizer );
+  }
+
+  static void fill_token_costs( Encoder & encoder, const ProbabilityTables & probability_tables )
+  {
+    encoder.costs_.fill_token_costs( probability_tables );
+  }
+};
+
+/* results of kernels that only return a value land here, so that the
+   calls cannot be optimized away */
+static volatile uint32_t sink;
+
+static chrono::milliseconds measure_for { 200 };
+
+/* Calls call( 0 ) .. call( count - 1 ), pass after pass, until the calls
+   add up to measure_for, running prepare() untimed before each pass.
+   Returns nanoseconds per call, or NaN when there is nothing to call. */
+template <class Prepare, class Call>
+static double ns_per_call( const size_t count, const Prepare & prepare, const Call & call )
+{
+  if ( count == 0 ) {
+    return numeric_limits<double>::quiet_NaN();
+  }
+
+  chrono::nanoseconds elapsed { 0 };
+  uint64_t calls = 0;
+
+  while ( elapsed < measure_for ) {
+    prepare();
+
+    const auto start = chrono::steady_clock::now();
+    for ( size_t i = 0; i < count; i++ ) {
+      call( i );
+    }
+    elapsed += chrono::steady_clock::now() - start;
+
+    calls += count;
+  }
+
+  return double( elapsed.count() ) / calls;
+}
+
+template <class Call>
+static double ns_per_call( const size_t count, const Call & call )
+{
+  return ns_per_call( count, [] () {}, call );
+}
+
+/* the blocks of a raster, by kind, in macroblock order */
+struct Blocks
+{
+  vector<VP8Raster::Macroblock> macroblocks {};
+  vector<VP8Raster::Block16 *> Y {};
+  vector<VP8Raster::Block8 *> U {}, V {};
+  vector<VP8Raster::Block4 *> Y_sub {};
+
+  Blocks( VP8Raster & raster )
+  {
+    macroblocks.reserve( raster.macroblock_width() * raster.macroblock_height() );
+
+    for ( unsigned int row = 0; row < raster.macroblock_height(); row++ ) {
+      for ( unsigned int column = 0; column < raster.macroblock_width(); column++ ) {
+        macroblocks.emplace_back( raster, column, row );
+
+        VP8Raster::Macroblock & macroblock = macroblocks.back();
+        Y.push_back( &macroblock.Y );
+        U.push_back( &macroblock.U );
+        V.push_back( &macroblock.V );
+        macroblock.Y_sub.forall( [&] ( VP8Raster::Block4 & block ) { Y_sub.push_back( &block ); } );
+      }
+    }
+  }
+};
+
+/* What the kernels run on: a picture, and the coefficients and bits
+   that could have coded it */
+struct Inputs
+{
+  string name;
+
+  MutableRasterHandle picture;
+
+  /* what the kernels write into, and an intra prediction of the
+     picture to measure distortion against */
+  MutableRasterHandle scratch, prediction;
+
+  Blocks picture_blocks, scratch_blocks, prediction_blocks;
+
+  ProbabilityTables probability_tables {};
+
+  /* quantized Y coefficients as parse_tokens produces them, one for
+     each block in raster order */
+  unsigned int blocks_wide, blocks_high;
+  vector<DCTCoefficients> coefficients {};
+  vector<bool> without_Y2 {};
+
+  /* dequantized Y and UV coefficients, and Y2 coefficients */
+  vector<DCTCoefficients> residues {}, walsh {};
+
+  /* symbols for the boolean coder, with the probability of each */
+  vector<bool> bits {};
+  vector<Probability> probabilities {};
+
+  Inputs( const string & s_name, const uint16_t width, const uint16_t height )
+    : name( s_name ),
+      picture( width, height ), scratch( width, height ), prediction( width, height ),
+      picture_blocks( picture ), scratch_blocks( scratch ), prediction_blocks( prediction ),
+      blocks_wide( 4 * picture.get().macroblock_width() ),
+      blocks_high( 4 * picture.get().macroblock_height() )
+  {}
+
+  /* once the picture is in place */
+  void finish( default_random_engine & generator )
+  {
+    picture.get().extend_borders();
+    scratch.get().copy_from( picture );
+
+    for ( size_t i = 0; i < picture_blocks.macroblocks.size(); i++ ) {
+      picture_blocks.Y.at( i )->intra_predict( TM_PRED, prediction_blocks.Y.at( i )->mutable_contents() );
+      picture_blocks.U.at( i )->intra_predict( TM_PRED, prediction_blocks.U.at( i )->mutable_contents() );
+      picture_blocks.V.at( i )->intra_predict( TM_PRED, prediction_blocks.V.at( i )->mutable_contents() );
+    }
+
+    /* each symbol drawn with the odds it is coded at */
+    uniform_int_distribution<unsigned int> octet( 0, 255 );
+    for ( const Probability probability : probabilities ) {
+      bits.push_back( octet( generator ) >= probability );
+    }
+  }
+};
+
+static const size_t bool_symbols = 1 << 20;
+
+/* random pixels, and coefficients that thin out with frequency as
+   those of a transformed residue do */
+static void make_synthetic( Inputs & inputs, default_random_engine & generator )
+{
+  uniform_int_distribution<unsigned int> octet( 0, 255 );
+
+  for ( TwoD<uint8_t> * plane : { &inputs.picture.get().Y(), &inputs.picture.get().U(), &inputs.picture.get().V() } ) {
+    plane->forall( [&] ( uint8_t & pixel ) { pixel = octet( generator ); } );
+  }
+
+  uniform_int_distribution<int> level( -40, 40 );
+
+  auto random_coefficients = [&] ( const unsigned int first_index ) {
+    DCTCoefficients coefficients;
+    for ( unsigned int index = first_index; index < 16; index++ ) {
+      if ( octet( generator ) % ( index + 2 ) == 0 ) {
+        coefficients.at( zigzag.at( index ) ) = level( generator ) / int( index + 1 );
+      }
+    }
+    return coefficients;
+  };
+
+  /* a quarter of the blocks without a Y2 block, as in B_PRED macroblocks */
+  for ( unsigned int i = 0; i < inputs.blocks_wide * inputs.blocks_high; i++ ) {
+    const bool without_Y2 = octet( generator ) < 64;
+    inputs.coefficients.push_back( random_coefficients( without_Y2 ? 0 : 1 ) );
+    inputs.without_Y2.push_back( without_Y2 );
+  }
+
+  for ( const DCTCoefficients & coefficients : inputs.coefficients ) {
+    inputs.residues.push_back( coefficients.dequantize( 20, 24 ) );
+  }
+
+  for ( size_t i = 0; i < inputs.picture_blocks.macroblocks.size(); i++ ) {
+    inputs.walsh.push_back( random_coefficients( 0 ).dequantize( 40, 50 ) );
+  }
+
+  for ( size_t i = 0; i < bool_symbols; i++ ) {
+    inputs.probabilities.push_back( 1 + octet( generator ) % 255 );
+  }
+
+  inputs.finish( generator );
+}
+
+/* the first frame shown, and the coefficients and probability tables of
+   the first key frame */
+static void read_real( Inputs & inputs, const IVF & file, default_random_engine & generator )
+{
+  Player player( inputs.name );
+  inputs.picture.get().copy_from( player.advance().get() );
+
+  for ( uint32_t frame_no = 0; frame_no < file.frame_count(); frame_no++ ) {
+    const UncompressedChunk chunk( file.frame( frame_no ), file.width(), file.height() );
+    if ( not chunk.key_frame() ) {
+      continue;
+    }
+
+    DecoderState state( file.width(), file.height() );
+    KeyFrame frame = state.parse_and_apply<KeyFrame>( chunk );
+    const Quantizer quantizer( frame.header().quant_indices );
+
+    inputs.coefficients.resize( inputs.blocks_wide * inputs.blocks_high );
+    inputs.without_Y2.resize( inputs.blocks_wide * inputs.blocks_high );
+
+    frame.mutable_macroblocks().forall_ij(
+      [&] ( KeyFrameMacroblock & macroblock, const unsigned int mb_column, const unsigned int mb_row )
+      {
+        macroblock.Y().forall_ij(
+          [&] ( YBlock & block, const unsigned int column, const unsigned int row )
+          {
+            const unsigned int index = ( 4 * mb_row + row ) * inputs.blocks_wide + 4 * mb_column + column;
+            inputs.coefficients.at( index ) = block.coefficients();
+            inputs.without_Y2.at( index ) = block.type() == Y_without_Y2;
+            inputs.residues.push_back( block.dequantize( quantizer ) );
+          } );
+
+        macroblock.U().forall( [&] ( UVBlock & block ) { inputs.residues.push_back( block.dequantize( quantizer ) ); } );
+        macroblock.V().forall( [&] ( UVBlock & block ) { inputs.residues.push_back( block.dequantize( quantizer ) ); } );
+
+        if ( macroblock.Y2().coded() ) {
+          inputs.walsh.push_back( macroblock.Y2().dequantize( quantizer ) );
+        }
+      } );
+
+    inputs.probability_tables = state.probability_tables;
+
+    /* the token probabilities the frame was coded with, in turn */
+    const auto & coeff_probs = inputs.probability_tables.coeff_probs;
+    while ( inputs.probabilities.size() < bool_symbols ) {
+      for ( unsigned int i = 0; i < coeff_probs.size(); i++ ) {
+        for ( unsigned int j = 0; j < coeff_probs.at( i ).size(); j++ ) {
+          for ( unsigned int k = 0; k < coeff_probs.at( i ).at( j ).size(); k++ ) {
+            for ( unsigned int l = 0; l < coeff_probs.at( i ).at( j ).at( k ).size(); l++ ) {
+              inputs.probabilities.push_back( coeff_probs.at( i ).at( j ).at( k ).at( l ) );
+            }
+          }
+        }
+      }
+    }
+    inputs.probabilities.resize( bool_symbols );
+
+    inputs.finish( generator );
+    return;
+  }
+
+  throw Invalid( "no key frame in " + inputs.name );
+}
+
+struct Kernel
+{
+  string name;
+  function<double( Inputs & )> time;
+};
+
+template <class BlockType, class PredictionMode>
+static double time_intra_predict( const vector<BlockType *> & blocks, const vector<BlockType *> & output,
+                                  const PredictionMode mode )
+{
+  return ns_per_call( blocks.size(), [&] ( const size_t i ) {
+      blocks[ i ]->intra_predict( mode, output[ i ]->mutable_contents() );
+    } );
+}
+
+/* a pixel down and to the right, plus each of the seven subpixel
+   positions in turn along the directions that are filtered */
+template <class BlockType>
+static double time_inter_predict( const vector<BlockType *> & blocks, const TwoD<uint8_t> & reference,
+                                  const bool horizontal, const bool vertical )
+{
+  return ns_per_call( blocks.size(), [&] ( const size_t i ) {
+      const int fraction = 1 + i % 7;
+      const MotionVector mv( 8 + ( horizontal ? fraction : 0 ), 8 + ( vertical ? fraction : 0 ) );
+      BlockType & block = *blocks[ i ];
+      block.unsafe_inter_predict( mv, reference,
+                                  block.context().column * BlockType::dimension + ( mv.x() >> 3 ),
+                                  block.context().row * BlockType::dimension + ( mv.y() >> 3 ) );
+    } );
+}
+
+static double time_bool_decoder( Inputs & inputs )
+{
+  BoolEncoder encoder;
+  for ( size_t i = 0; i < inputs.bits.size(); i++ ) {
+    encoder.put( inputs.bits[ i ], inputs.probabilities[ i ] );
+  }
+  const vector<uint8_t> coded = encoder.finish();
+
+  unique_ptr<BoolDecoder> data;
+  return ns_per_call( inputs.bits.size(),
+                      [&] () { data.reset( new BoolDecoder( Chunk( coded.data(), coded.size() ) ) ); },
+                      [&] ( const size_t i ) { sink += data->get( inputs.probabilities[ i ] ); } );
+}
+
+static double time_bool_encoder( Inputs & inputs )
+{
+  unique_ptr<BoolEncoder> encoder;
+  return ns_per_call( inputs.bits.size(),
+                      [&] () { encoder.reset( new BoolEncoder ); },
+                      [&] ( const size_t i ) { encoder->put( inputs.bits[ i ], inputs.probabilities[ i ] ); } );
+}
+
+/* the Y blocks' tokens, coded in raster order so that each block's
+   context comes from the same neighbours the decoder sees */
+static double time_parse_tokens( Inputs & inputs )
+{
+  TwoD<YBlock> original( inputs.blocks_wide, inputs.blocks_high ), parsed( inputs.blocks_wide, inputs.blocks_high );
+  vector<YBlock *> blocks;
+
+  BoolEncoder encoder;
+  original.forall_ij( [&] ( YBlock & block, const unsigned int column, const unsigned int row ) {
+      const unsigned int index = row * inputs.blocks_wide + column;
+      YBlock & parsed_block = parsed.at( column, row );
+
+      if ( inputs.without_Y2.at( index ) ) {
+        block.set_Y_without_Y2();
+        parsed_block.set_Y_without_Y2();
+      }
+
+      block.mutable_coefficients() = inputs.coefficients.at( index );
+      block.calculate_has_nonzero();
+      block.serialize_tokens( encoder, inputs.probability_tables );
+
+      blocks.push_back( &parsed_block );
+    } );
+  const vector<uint8_t> coded = encoder.finish();
+
+  /* every pass parses the same tokens into the same blocks, so what
+     the last pass leaves behind need not be cleared */
+  unique_ptr<BoolDecoder> data;
+  const double ns = ns_per_call( blocks.size(),
+                                 [&] () { data.reset( new BoolDecoder( Chunk( coded.data(), coded.size() ) ) ); },
+                                 [&] ( const size_t i ) { blocks[ i ]->parse_tokens( *data, inputs.probability_tables ); } );
+
+  original.forall_ij( [&] ( const YBlock & block, const unsigned int column, const unsigned int row ) {
+      if ( block.coefficients() != parsed.at( column, row ).coefficients() ) {
+        throw LogicError();
+      }
+    } );
+
+  return ns;
+}
+
+static double time_loopfilter( Inputs & inputs, const function<void( VP8Raster::MacroblockPixels & )> & filter )
+{
+  VP8Raster & scratch = inputs.scratch.get();
+  vector<VP8Raster::MacroblockPixels> macroblocks;
+  for ( unsigned int row = 0; row < scratch.macroblock_height(); row++ ) {
+    for ( unsigned int column = 0; column < scratch.macroblock_width(); column++ ) {
+      macroblocks.push_back( scratch.macroblock_pixels( column, row ) );
+    }
+  }
+
+  return ns_per_call( macroblocks.size(),
+                      [&] () { inputs.scratch.get().copy_from( inputs.picture ); },
+                      [&] ( const size_t i ) { filter( macroblocks[ i ] ); } );
+}
+
+/* the residue of each 4x4 block of the picture from its prediction */
+static vector<DCTCoefficients> residue_dcts( const Inputs & inputs )
+{
+  vector<DCTCoefficients> dcts( inputs.picture_blocks.Y_sub.size() );
+  for ( size_t i = 0; i < dcts.size(); i++ ) {
+    dcts[ i ].subtract_dct( *inputs.picture_blocks.Y_sub[ i ], inputs.prediction_blocks.Y_sub[ i ]->contents() );
+  }
+  return dcts;
+}
+
+static double time_trellis_quantize( Inputs & inputs )
+{
+  const vector<DCTCoefficients> dcts = residue_dcts( inputs );
+
+  TwoD<YBlock> blocks( inputs.blocks_wide, inputs.blocks_high );
+  vector<YBlock *> block_order;
+  blocks.forall( [&] ( YBlock & block ) { block.set_Y_without_Y2(); block_order.push_back( &block ); } );
+
+  TempFile unused_output( "/tmp/kernel-bench" );
+  Encoder encoder( unused_output.name(), inputs.picture.get().display_width(),
+                   inputs.picture.get().display_height(), false );
+  KernelBench::fill_token_costs( encoder, inputs.probability_tables );
+
+  QuantIndices quant_indices;
+  quant_indices.y_ac_qi = 40;
+  const Quantizer quantizer( quant_indices );
+
+  /* the unquantized coefficients are copied in before every call */
+  return ns_per_call( block_order.size(), [&] ( const size_t i ) {
+      block_order[ i ]->mutable_coefficients() = dcts[ i ];
+      KernelBench::trellis_quantize( encoder, *block_order[ i ], quantizer );
+    } );
+}
+
+static vector<Kernel> all_kernels( void )
+{
+  vector<Kernel> kernels;
+
+  kernels.push_back( { "BoolDecoder::get", time_bool_decoder } );
+  kernels.push_back( { "BoolEncoder::put", time_bool_encoder } );
+  kernels.push_back( { "Block::parse_tokens (Y)", time_parse_tokens } );
+
+  kernels.push_back( { "DCTCoefficients::idct_add", [] ( Inputs & inputs ) {
+        const vector<VP8Raster::Block4 *> & blocks = inputs.scratch_blocks.Y_sub;
+        return ns_per_call( blocks.size(),
+                            [&] () { inputs.scratch.get().copy_from( inputs.picture ); },
+                            [&] ( const size_t i ) {
+                              inputs.residues[ i % inputs.residues.size() ].idct_add( *blocks[ i ] );
+                            } ); } } );
+
+  kernels.push_back( { "DCTCoefficients::iwht", [] ( Inputs & inputs ) {
+        return ns_per_call( inputs.walsh.size(), [&] ( const size_t i ) {
+            sink += inputs.walsh[ i ].iwht().at( 0 ).at( 0 );
+          } ); } } );
+
+  const array<pair<mbmode, const char *>, 4> mb_modes {{
+      { DC_PRED, "DC_PRED" }, { V_PRED, "V_PRED" }, { H_PRED, "H_PRED" }, { TM_PRED, "TM_PRED" } }};
+
+  for ( const auto & mode : mb_modes ) {
+    kernels.push_back( { string( "intra_predict 16x16 " ) + mode.second, [mode] ( Inputs & inputs ) {
+          return time_intra_predict( inputs.picture_blocks.Y, inputs.scratch_blocks.Y, mode.first ); } } );
+  }
+
+  for ( const auto & mode : mb_modes ) {
+    kernels.push_back( { string( "intra_predict 8x8 " ) + mode.second, [mode] ( Inputs & inputs ) {
+          return time_intra_predict( inputs.picture_blocks.U, inputs.scratch_blocks.U, mode.first ); } } );
+  }
+
+  const array<const char *, num_intra_b_modes> b_mode_names {{
+      "B_DC_PRED", "B_TM_PRED", "B_VE_PRED", "B_HE_PRED", "B_LD_PRED",
+      "B_RD_PRED", "B_VR_PRED", "B_VL_PRED", "B_HD_PRED", "B_HU_PRED" }};
+
+  for ( unsigned int mode = 0; mode < num_intra_b_modes; mode++ ) {
+    kernels.push_back( { string( "intra_predict 4x4 " ) + b_mode_names.at( mode ), [mode] ( Inputs & inputs ) {
+          return time_intra_predict( inputs.picture_blocks.Y_sub, inputs.scratch_blocks.Y_sub, bmode( mode ) ); } } );
+  }
+
+  const array<pair<pair<bool, bool>, const char *>, 4> subpixel_filters {{
+      { { false, false }, "full pixel" }, { { true, false }, "horizontal" },
+      { { false, true }, "vertical" }, { { true, true }, "two-pass" } }};
+
+  for ( const auto & filter : subpixel_filters ) {
+    const bool horizontal = filter.first.first, vertical = filter.first.second;
+
+    kernels.push_back( { string( "unsafe_inter_predict 16x16 " ) + filter.second, [=] ( Inputs & inputs ) {
+          return time_inter_predict( inputs.scratch_blocks.Y, inputs.picture.get().Y(), horizontal, vertical ); } } );
+    kernels.push_back( { string( "unsafe_inter_predict 8x8 " ) + filter.second, [=] ( Inputs & inputs ) {
+          return time_inter_predict( inputs.scratch_blocks.U, inputs.picture.get().U(), horizontal, vertical ); } } );
+    kernels.push_back( { string( "unsafe_inter_predict 4x4 " ) + filter.second, [=] ( Inputs & inputs ) {
+          return time_inter_predict( inputs.scratch_blocks.Y_sub, inputs.picture.get().Y(), horizontal, vertical ); } } );
+  }
+
+  /* the same moderate strength for both inputs, so only the pixels differ */
+  kernels.push_back( { "SimpleLoopFilter::filter", [] ( Inputs & inputs ) {
+        SimpleLoopFilter filter( FilterParameters( true, 32, 0 ) );
+        return time_loopfilter( inputs, [&] ( VP8Raster::MacroblockPixels & macroblock ) { filter.filter( macroblock, false ); } ); } } );
+
+  kernels.push_back( { "NormalLoopFilter::filter", [] ( Inputs & inputs ) {
+        NormalLoopFilter filter( true, FilterParameters( false, 32, 0 ) );
+        return time_loopfilter( inputs, [&] ( VP8Raster::MacroblockPixels & macroblock ) { filter.filter( macroblock, false ); } ); } } );
+
+  kernels.push_back( { "Encoder::sse 4x4", [] ( Inputs & inputs ) {
+        return ns_per_call( inputs.picture_blocks.Y_sub.size(), [&] ( const size_t i ) {
+            sink += KernelBench::sse( *inputs.picture_blocks.Y_sub[ i ], inputs.prediction_blocks.Y_sub[ i ]->contents() );
+          } ); } } );
+
+  kernels.push_back( { "Encoder::sse 8x8", [] ( Inputs & inputs ) {
+        return ns_per_call( inputs.picture_blocks.U.size(), [&] ( const size_t i ) {
+            sink += KernelBench::sse( *inputs.picture_blocks.U[ i ], inputs.prediction_blocks.U[ i ]->contents() );
+          } ); } } );
+
+  kernels.push_back( { "Encoder::variance 16x16", [] ( Inputs & inputs ) {
+        return ns_per_call( inputs.picture_blocks.Y.size(), [&] ( const size_t i ) {
+            sink += KernelBench::variance( *inputs.picture_blocks.Y[ i ], inputs.prediction_blocks.Y[ i ]->contents() );
+          } ); } } );
+
+  kernels.push_back( { "DCTCoefficients::subtract_dct", [] ( Inputs & inputs ) {
+        vector<DCTCoefficients> dcts( inputs.picture_blocks.Y_sub.size() );
+        return ns_per_call( dcts.size(), [&] ( const size_t i ) {
+            dcts[ i ].subtract_dct( *inputs.picture_blocks.Y_sub[ i ], inputs.prediction_blocks.Y_sub[ i ]->contents() );
+          } ); } } );
+
+  kernels.push_back( { "Encoder::trellis_quantize (Y)", time_trellis_quantize } );
+
+  return kernels;
+}
+
+void usage_error( const string & program_name )
+{
+  cerr << "Usage: " << program_name << " [options] [<input>]" << endl
+       << endl
+       << "Times each kernel on random data and, given an IVF file, on its first frames." << endl
+       << endl
+       << "Options:" << endl
+       << " -t <ms>,  --time=<ms>                 Whole milliseconds, at least 1, to spend timing each kernel" << endl
+       << "                                         on each input (default: 200)" << endl
+       << " -k <arg>, --kernel=<arg>              Only time kernels whose name contains <arg>" << endl;
+}
+
+int main( int argc, char *argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    string kernel_filter;
+
+    const option command_line_options[] = {
+      { "time", required_argument, nullptr, 't' },
+      { "kernel", required_argument, nullptr, 'k' },
+      { 0, 0, nullptr, 0 }
+    };
+
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "t:k:", command_line_options, nullptr );
+
+      if ( opt == -1 ) {
+        break;
+      }
+
+      switch ( opt ) {
+      case 't':
+        {
+          /* a fraction of a millisecond would time no passes at all */
+          const string milliseconds = optarg;
+          if ( milliseconds.empty() or milliseconds.find_first_not_of( "0123456789" ) != string::npos
+               or stoul( milliseconds ) < 1 ) {
+            usage_error( argv[ 0 ] );
+            return EXIT_FAILURE;
+          }
+          measure_for = chrono::milliseconds( stoul( milliseconds ) );
+        }
+        break;
+
+      case 'k':
+        kernel_filter = optarg;
+        break;
+
+      default:
+        usage_error( argv[ 0 ] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    if ( optind < argc - 1 ) {
+      usage_error( argv[ 0 ] );
+      return EXIT_FAILURE;
+    }
+
+    /* the same inputs from one run to the next */
+    default_random_engine generator( 0 );
+
+    vector<unique_ptr<Inputs>> inputs;
+    inputs.emplace_back( new Inputs( "synthetic", 352, 288 ) );
+    make_synthetic( *inputs.back(), generator );
+
+    if ( optind == argc - 1 ) {
+      const IVF file( argv[ optind ] );
+      if ( file.fourcc() != "VP80" ) {
+        throw Unsupported( "not a VP8 file" );
+      }
+
+      inputs.emplace_back( new Inputs( argv[ optind ], file.width(), file.height() ) );
+      read_real( *inputs.back(), file, generator );
+    }
+
+    cout << "# nanoseconds per call";
+    for ( const auto & input : inputs ) {
+      cout << ", " << input->name << " (" << input->picture.get().display_width()
+           << "x" << input->picture.get().display_height() << ")";
+    }
+    cout << endl;
+
+    cout << fixed << setprecision( 1 );
+
+    for ( const Kernel & kernel : all_kernels() ) {
+      if ( kernel.name.find( kernel_filter ) == string::npos ) {
+        continue;
+      }
+
+      cout << left << setw( 40 ) << kernel.name << right;
+      for ( const auto & input : inputs ) {
+        double ns;
+        try {
+          ns = kernel.time( *input );
+        } catch ( const Unsupported & ) {
+          /* e.g. the simple loop filter, which the decoder lacks */
+          cout << setw( 12 ) << "unsupported";
+          continue;
+        }
+
+        if ( ns == ns ) {
+          cout << setw( 12 ) << ns;
+        } else {
+          /* nothing of this kind in the input */
+          cout << setw( 12 ) << "-";
+        }
+      }
+      cout << endl;
+    }
+  } catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
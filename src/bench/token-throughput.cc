@@ -0,0 +1,95 @@
+#include <iostream>
+
+#include "ivf.hh"
+#include "uncompressed_chunk.hh"
+#include "decoder_state.hh"
+#include "frame_arena.hh"
+#include "decode_timer.hh"
+
+using namespace std;
+
+/* Coefficients the token decoder produced for a frame: 16 for every Y,
+   U and V block, plus 16 for the Y2 block when it is coded. The zeros
+   implied after an end-of-block token count, just as they would for a
+   decoder that writes them out. */
+template <class FrameType>
+static uint64_t coefficient_count( const FrameType & frame )
+{
+  uint64_t total = 0;
+
+  frame.macroblocks().forall( [&] ( decltype( frame.macroblocks().at( 0, 0 ) ) macroblock ) {
+      const mbmode y_mode = macroblock.y_prediction_mode();
+      total += ( 16 + 4 + 4 ) * 16 + ( ( y_mode == B_PRED or y_mode == SPLITMV ) ? 0 : 16 );
+    } );
+
+  return total;
+}
+
+/* parses the frame's headers and tokens from the same starting state,
+   repeatedly, and returns how many coefficients one pass decodes; only
+   the token partitions' parsing is timed (by its DecodeTimer) */
+template <class FrameType>
+static uint64_t parse_frame( DecoderState & state, const UncompressedChunk & chunk,
+			     FrameArena & arena, const unsigned int iterations )
+{
+  DecodeTimer::enable( true );
+
+  for ( unsigned int i = 0; i < iterations; i++ ) {
+    DecoderState scratch_state( state );
+    scratch_state.parse_and_apply<FrameType>( chunk, nullptr, &arena );
+  }
+
+  DecodeTimer::enable( false );
+
+  return coefficient_count( state.parse_and_apply<FrameType>( chunk, nullptr, &arena ) );
+}
+
+int main( int argc, char *argv[] )
+{
+  try {
+    if ( argc != 2 and argc != 3 ) {
+      cerr << "Usage: " << argv[ 0 ] << " FILENAME [ITERATIONS]" << endl;
+      return EXIT_FAILURE;
+    }
+
+    const IVF file( argv[ 1 ] );
+    const unsigned int iterations = argc == 3 ? stoul( argv[ 2 ] ) : 10;
+
+    DecoderState state( file.width(), file.height() );
+    const shared_ptr<FrameArena> arena = make_shared<FrameArena>();
+    bool seen_key_frame = false;
+    uint64_t frames_parsed = 0;
+
+    uint64_t coefficients = 0;
+    DecodeTimer::reset();
+
+    for ( uint32_t frame_no = 0; frame_no < file.frame_count(); frame_no++ ) {
+      UncompressedChunk chunk( file.frame( frame_no ), file.width(), file.height() );
+
+      if ( chunk.key_frame() ) {
+	seen_key_frame = true;
+	coefficients += parse_frame<KeyFrame>( state, chunk, *arena, iterations );
+	frames_parsed += iterations + 1;
+      } else if ( seen_key_frame ) {
+	coefficients += parse_frame<InterFrame>( state, chunk, *arena, iterations );
+	frames_parsed += iterations + 1;
+      }
+    }
+
+    const double seconds = DecodeTimer::nanoseconds( DecodeStage::Tokens ) / 1e9;
+
+    cout << argv[ 1 ] << ": " << coefficients << " coefficients per pass, "
+	 << coefficients * iterations / seconds / 1e6 << " million coefficients/s" << endl;
+
+    /* each frame needs four block arrays and one macroblock array */
+    const FrameArena::Statistics arena_statistics = arena->statistics();
+    cout << "frame arrays: " << arena_statistics.allocations << " allocated, "
+	 << arena_statistics.reuses << " reused, "
+	 << double( arena_statistics.allocations ) / max<uint64_t>( frames_parsed, 1 ) << " allocations per frame" << endl;
+  } catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
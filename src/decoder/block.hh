@@ -89,6 +89,9 @@ private:
 
   MotionVector motion_vector_ {};
 
+  template <BlockType block_type>
+  void parse_tokens_as( BoolDecoder & data, const ProbabilityTables & probability_tables );
+
 public:
   Block( const typename TwoD< Block >::Context & context )
     : context_( context )
@@ -175,6 +178,17 @@ public:
 
   void zero_out();
 
+  /* forget everything parsed into this block, keeping its position */
+  void reset( void )
+  {
+    coefficients_.reinitialize();
+    type_ = initial_block_type;
+    prediction_mode_ = PredictionMode {};
+    coded_ = true;
+    has_nonzero_ = false;
+    motion_vector_ = MotionVector {};
+  }
+
   bool operator==( const Block & other ) const
   {
     return type_ == other.type_ and
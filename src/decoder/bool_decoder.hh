@@ -1,6 +1,11 @@
 #ifndef BOOL_DECODER_HH
 #define BOOL_DECODER_HH
 
+#include <endian.h>
+
+#include <cstring>
+#include <algorithm>
+
 #include "chunk.hh"
 #include "safe_array.hh"
 
@@ -14,39 +19,92 @@ typedef uint8_t Probability;
 template < std::size_t alphabet_size >
 using ProbabilityArray = SafeArray< Probability, alphabet_size - 1 >;
 
+/* libvpx lookup table to avoid the need for a loop in
+ * BoolEncoder::put and BoolDecoder::get. Taken from libvpx/vp8/common/entropy.c
+ */
+const uint8_t vp8_norm[ 256 ] = {
+    0, 7, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
 class BoolDecoder
 {
 private:
-  Chunk chunk_;
-  
-  uint32_t range_, value_;
-  char bit_count_;
+  const uint8_t * buffer_, * buffer_end_;
+
+  uint32_t range_;
+
+  /* the coded value, most significant bit first; the top octet is
+     the part compared against the split */
+  uint64_t value_;
+
+  /* how many more bits the window holds below its top octet
+     (negative when the top octet itself is not yet full) */
+  int bit_count_;
 
-  void load_octet( void )
+  /* based on libvpx vp8dx_bool_decoder_fill() */
+  void fill( void )
   {
-    if ( chunk_.size() ) {
-      value_ |= chunk_.octet();
-      chunk_ = chunk_( 1 );
+    const int free_bits = 56 - bit_count_;
+    const unsigned int octets = free_bits >> 3;
+    const uint64_t remaining = buffer_end_ - buffer_;
+
+    if ( remaining >= sizeof( uint64_t ) ) {
+      /* fast path: one big-endian load */
+      uint64_t word;
+      std::memcpy( &word, buffer_, sizeof( word ) );
+      word = be64toh( word );
+
+      value_ |= ( word >> ( 64 - 8 * octets ) ) << ( free_bits - 8 * octets );
+      buffer_ += octets;
+    } else {
+      /* near the end of the partition, load what is left; past the end,
+	 the stream reads as zeros */
+      const unsigned int available = std::min( static_cast<uint64_t>( octets ), remaining );
+      for ( unsigned int i = 0; i < available; i++ ) {
+	value_ |= static_cast<uint64_t>( buffer_[ i ] ) << ( free_bits - 8 * ( i + 1 ) );
+      }
+      buffer_ += available;
     }
+
+    bit_count_ += 8 * octets;
   }
 
 public:
   BoolDecoder( const Chunk & s_chunk )
-    : chunk_( s_chunk ),
+    : buffer_( s_chunk.buffer() ),
+      buffer_end_( s_chunk.buffer() + s_chunk.size() ),
       range_( 255 ),
       value_( 0 ),
-      bit_count_( 0 )
+      bit_count_( -8 )
   {
-    load_octet();
-    value_ <<= 8;
-    load_octet();
+    fill();
   }
 
-  /* based on dixie bool_decoder.h */
+  /* based on dixie bool_decoder.h and libvpx vp8dx_decode_bool() */
   bool get( const Probability probability = 128 )
   {
     const uint32_t split = 1 + (((range_ - 1) * probability) >> 8);
-    const uint32_t SPLIT = split << 8;
+
+    if ( bit_count_ < 0 ) {
+      fill();
+    }
+
+    const uint64_t SPLIT = static_cast<uint64_t>( split ) << 56;
     bool ret;
 
     if ( value_ >= SPLIT ) { /* encoded a one */
@@ -58,14 +116,11 @@ public:
       range_ = split;
     }
 
-    while ( range_ < 128 ) {
-      value_ <<= 1;
-      range_ <<= 1;
-      if ( ++bit_count_ == 8 ) {
-	bit_count_ = 0;
-	load_octet();
-      }
-    }
+    /* renormalize in one step */
+    const uint8_t shift = vp8_norm[ range_ ];
+    range_ <<= shift;
+    value_ <<= shift;
+    bit_count_ -= shift;
 
     return ret;
   }
@@ -0,0 +1,282 @@
+#include <cstring>
+
+#include "checkpoint.hh"
+#include "decoder_state.hh"
+#include "file.hh"
+#include "file_descriptor.hh"
+#include "exception.hh"
+
+using namespace std;
+
+static const string checkpoint_magic = "VP8CKPT";
+
+static void append_le16( string & out, const uint16_t val )
+{
+  const uint16_t swizzled = htole16( val );
+  out.append( reinterpret_cast<const char *>( &swizzled ), sizeof( swizzled ) );
+}
+
+static void append_le32( string & out, const uint32_t val )
+{
+  const uint32_t swizzled = htole32( val );
+  out.append( reinterpret_cast<const char *>( &swizzled ), sizeof( swizzled ) );
+}
+
+static void append_le64( string & out, const uint64_t val )
+{
+  const uint64_t swizzled = htole64( val );
+  out.append( reinterpret_cast<const char *>( &swizzled ), sizeof( swizzled ) );
+}
+
+template <class Container>
+static void append_bytes( string & out, const Container & bytes )
+{
+  for ( const auto & byte : bytes ) {
+    out.push_back( byte );
+  }
+}
+
+static void append_plane( string & out, const TwoD<uint8_t> & plane )
+{
+  for ( unsigned int row = 0; row < plane.height(); row++ ) {
+    out.append( reinterpret_cast<const char *>( &plane.at( 0, row ) ), plane.width() );
+  }
+}
+
+/* reads a checkpoint front to back */
+class CheckpointReader
+{
+private:
+  Chunk remaining_;
+
+public:
+  CheckpointReader( const Chunk & data ) : remaining_( data ) {}
+
+  Chunk take( const uint64_t length )
+  {
+    const Chunk ret = remaining_( 0, length );
+    remaining_ = remaining_( length );
+    return ret;
+  }
+
+  uint8_t u8( void ) { return take( 1 ).octet(); }
+  uint16_t le16( void ) { return take( 2 ).le16(); }
+  uint32_t le32( void ) { return take( 4 ).le32(); }
+  uint64_t le64( void ) { return take( 8 ).le64(); }
+
+  template <class Container>
+  void bytes( Container & bytes )
+  {
+    const Chunk data = take( bytes.size() );
+    for ( unsigned int i = 0; i < bytes.size(); i++ ) {
+      bytes.at( i ) = data.buffer()[ i ];
+    }
+  }
+
+  void plane( TwoD<uint8_t> & plane )
+  {
+    for ( unsigned int row = 0; row < plane.height(); row++ ) {
+      memcpy( &plane.at( 0, row ), take( plane.width() ).buffer(), plane.width() );
+    }
+  }
+
+  uint64_t remaining( void ) const { return remaining_.size(); }
+  bool finished( void ) const { return remaining_.size() == 0; }
+};
+
+/* the magic and version, checked; then the frame number and source */
+static pair<unsigned int, DecoderCheckpoint::Source> read_header( CheckpointReader & reader, const string & filename )
+{
+  if ( reader.remaining() <= checkpoint_magic.size()
+       or reader.take( checkpoint_magic.size() + 1 ).to_string() != checkpoint_magic + '\0' ) {
+    throw Invalid( filename + " is not a decoder checkpoint" );
+  }
+
+  if ( reader.le32() != DecoderCheckpoint::version ) {
+    throw Unsupported( filename + " is from another version of the checkpoint format" );
+  }
+
+  const unsigned int frame_no = reader.le32();
+  const uint64_t size = reader.le64();
+  const uint64_t modification_time = reader.le64();
+
+  return make_pair( frame_no, DecoderCheckpoint::Source { size, modification_time } );
+}
+
+DecoderCheckpoint::DecoderCheckpoint( const unsigned int frame_no, const Source & source, Decoder && decoder )
+  : frame_no_( frame_no ),
+    source_( source ),
+    decoder_( move( decoder ) )
+{}
+
+void DecoderCheckpoint::write( const string & filename, const Decoder & decoder,
+                               const unsigned int frame_no, const Source & source )
+{
+  const DecoderState state = decoder.get_state();
+  const References references = decoder.get_references();
+  const DecoderHash hash = decoder.get_hash();
+
+  string out = checkpoint_magic;
+  out.push_back( 0 );
+  append_le32( out, version );
+  append_le32( out, frame_no );
+  append_le64( out, source.size );
+  append_le64( out, source.modification_time );
+  append_le16( out, state.width );
+  append_le16( out, state.height );
+
+  append_le64( out, hash.state_hash() );
+  append_le64( out, hash.last_hash() );
+  append_le64( out, hash.golden_hash() );
+  append_le64( out, hash.alt_hash() );
+
+  const ProbabilityTables & probability_tables = state.probability_tables;
+  for ( const auto & block_type : probability_tables.coeff_probs ) {
+    for ( const auto & band : block_type ) {
+      for ( const auto & context : band ) {
+        append_bytes( out, context );
+      }
+    }
+  }
+  append_bytes( out, probability_tables.y_mode_probs );
+  append_bytes( out, probability_tables.uv_mode_probs );
+  for ( const auto & component : probability_tables.motion_vector_probs ) {
+    append_bytes( out, component );
+  }
+
+  out.push_back( state.segmentation.initialized() );
+  if ( state.segmentation.initialized() ) {
+    const Segmentation & segmentation = state.segmentation.get();
+    out.push_back( segmentation.absolute_segment_adjustments );
+    append_bytes( out, segmentation.segment_quantizer_adjustments );
+    append_bytes( out, segmentation.segment_filter_adjustments );
+    append_plane( out, segmentation.map.get() );
+  }
+
+  out.push_back( state.filter_adjustments.initialized() );
+  if ( state.filter_adjustments.initialized() ) {
+    append_bytes( out, state.filter_adjustments.get().loopfilter_ref_adjustments );
+    append_bytes( out, state.filter_adjustments.get().loopfilter_mode_adjustments );
+  }
+
+  /* references often share a raster; store each one once */
+  const RasterHandle * const slots[] = { &references.last, &references.golden,
+                                         &references.alternative_reference };
+  vector<const VP8Raster *> rasters;
+  for ( const RasterHandle * slot : slots ) {
+    unsigned int index = 0;
+    while ( index < rasters.size() and rasters.at( index ) != &slot->get() ) {
+      index++;
+    }
+    if ( index == rasters.size() ) {
+      rasters.push_back( &slot->get() );
+    }
+    out.push_back( index );
+  }
+
+  for ( const VP8Raster * raster : rasters ) {
+    append_plane( out, raster->Y() );
+    append_plane( out, raster->U() );
+    append_plane( out, raster->V() );
+  }
+
+  replace_file( filename, out );
+}
+
+DecoderCheckpoint DecoderCheckpoint::read( const string & filename )
+{
+  const File file( filename );
+  CheckpointReader reader( file.chunk() );
+
+  const pair<unsigned int, Source> header = read_header( reader, filename );
+  const uint16_t width = reader.le16();
+  const uint16_t height = reader.le16();
+
+  const uint64_t state_hash = reader.le64();
+  const uint64_t last_hash = reader.le64();
+  const uint64_t golden_hash = reader.le64();
+  const uint64_t alt_hash = reader.le64();
+  const DecoderHash expected_hash( state_hash, last_hash, golden_hash, alt_hash );
+
+  DecoderState state( width, height );
+
+  ProbabilityTables & probability_tables = state.probability_tables.mutate();
+  for ( unsigned int i = 0; i < probability_tables.coeff_probs.size(); i++ ) {
+    for ( unsigned int j = 0; j < probability_tables.coeff_probs.at( i ).size(); j++ ) {
+      for ( unsigned int k = 0; k < probability_tables.coeff_probs.at( i ).at( j ).size(); k++ ) {
+        reader.bytes( probability_tables.coeff_probs.at( i ).at( j ).at( k ) );
+      }
+    }
+  }
+  reader.bytes( probability_tables.y_mode_probs );
+  reader.bytes( probability_tables.uv_mode_probs );
+  for ( unsigned int i = 0; i < probability_tables.motion_vector_probs.size(); i++ ) {
+    reader.bytes( probability_tables.motion_vector_probs.at( i ) );
+  }
+
+  if ( reader.u8() ) {
+    SegmentationMap map( ( width + 15 ) / 16, ( height + 15 ) / 16 );
+    Segmentation segmentation( move( map ) );
+    segmentation.absolute_segment_adjustments = reader.u8();
+    reader.bytes( segmentation.segment_quantizer_adjustments );
+    reader.bytes( segmentation.segment_filter_adjustments );
+    reader.plane( segmentation.map.mutate() );
+    state.segmentation.initialize( move( segmentation ) );
+  }
+
+  if ( reader.u8() ) {
+    FilterAdjustments filter_adjustments;
+    reader.bytes( filter_adjustments.loopfilter_ref_adjustments );
+    reader.bytes( filter_adjustments.loopfilter_mode_adjustments );
+    state.filter_adjustments.initialize( move( filter_adjustments ) );
+  }
+
+  unsigned int slots[ 3 ];
+  unsigned int raster_count = 0;
+  for ( unsigned int & slot : slots ) {
+    slot = reader.u8();
+    if ( slot > raster_count ) {
+      throw Invalid( filename + " has a reference to a missing raster" );
+    }
+    raster_count = max( raster_count, slot + 1 );
+  }
+
+  vector<RasterHandle> rasters;
+  for ( unsigned int i = 0; i < raster_count; i++ ) {
+    MutableRasterHandle raster( width, height );
+    reader.plane( raster.get().Y() );
+    reader.plane( raster.get().U() );
+    reader.plane( raster.get().V() );
+    raster.get().extend_borders();
+    rasters.emplace_back( move( raster ) );
+  }
+
+  if ( not reader.finished() ) {
+    throw Invalid( filename + " has trailing data" );
+  }
+
+  References references( width, height );
+  references.last = rasters.at( slots[ 0 ] );
+  references.golden = rasters.at( slots[ 1 ] );
+  references.alternative_reference = rasters.at( slots[ 2 ] );
+
+  Decoder decoder( move( state ), move( references ) );
+
+  if ( decoder.get_hash() != expected_hash ) {
+    throw Invalid( filename + " does not match the decoder it was saved from" );
+  }
+
+  return DecoderCheckpoint( header.first, header.second, move( decoder ) );
+}
+
+bool DecoderCheckpoint::saved_from( const string & filename, const unsigned int frame_no, const Source & source )
+{
+  try {
+    const File file( filename );
+    CheckpointReader reader( file.chunk() );
+
+    return read_header( reader, filename ) == make_pair( frame_no, source );
+  } catch ( const exception & ) {
+    return false;
+  }
+}
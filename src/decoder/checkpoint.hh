@@ -0,0 +1,58 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+
+#include <string>
+
+#include "decoder.hh"
+
+/* A Decoder saved to disk between two frames of a stream: the decoder
+   state, the three references (each distinct raster stored once), and
+   the DecoderHash they add up to, which is checked when the checkpoint
+   is mapped back in. Resuming from one replaces decoding everything
+   since the last key frame. */
+class DecoderCheckpoint
+{
+public:
+  /* the file a checkpoint was saved from, told apart from a rewritten
+     one by its size and modification time (both 0 for a stream) */
+  struct Source
+  {
+    uint64_t size, modification_time;
+
+    bool operator==( const Source & other ) const
+    {
+      return size == other.size and modification_time == other.modification_time;
+    }
+
+    bool operator!=( const Source & other ) const { return not operator==( other ); }
+  };
+
+private:
+  unsigned int frame_no_;
+  Source source_;
+  Decoder decoder_;
+
+  DecoderCheckpoint( const unsigned int frame_no, const Source & source, Decoder && decoder );
+
+public:
+  static constexpr uint32_t version = 2;
+
+  /* decoder is ready to decode frame_no of source; the file is written
+     under a temporary name and renamed into place */
+  static void write( const std::string & filename, const Decoder & decoder,
+                     const unsigned int frame_no, const Source & source );
+
+  /* throws if the file is not a checkpoint of this version, or if what
+     it holds does not hash to what was saved */
+  static DecoderCheckpoint read( const std::string & filename );
+
+  /* whether the file is a checkpoint of this version, saved before
+     frame_no of source; only its header is read */
+  static bool saved_from( const std::string & filename, const unsigned int frame_no, const Source & source );
+
+  unsigned int frame_no( void ) const { return frame_no_; }
+  const Source & source( void ) const { return source_; }
+  const Decoder & decoder( void ) const { return decoder_; }
+};
+
+#endif /* CHECKPOINT_HH */
@@ -0,0 +1,49 @@
+#include "decode_ahead.hh"
+
+using namespace std;
+
+DecodeAhead::DecodeAhead( const string & filename, const unsigned int depth, const unsigned int thread_count )
+  : player_( filename ),
+    example_raster_( player_.width(), player_.height() ),
+    decoded_frames_( depth )
+{
+  player_.set_thread_count( thread_count );
+
+  decoder_ = thread( [this] () { decode_all(); } );
+}
+
+DecodeAhead::~DecodeAhead()
+{
+  decoded_frames_.shut_down();
+  decoder_.join();
+}
+
+void DecodeAhead::decode_all( void )
+{
+  while ( not player_.eof() ) {
+    if ( not decoded_frames_.wait_for_room() ) {
+      return;
+    }
+
+    Optional<DecodedFrame> decoded_frame;
+
+    try {
+      const auto start = chrono::steady_clock::now();
+      RasterHandle raster = player_.advance();
+      decoded_frame.initialize( DecodedFrame { move( raster ), player_.cur_frame_no(),
+                                               chrono::steady_clock::now() - start } );
+    } catch ( ... ) {
+      decoded_frames_.fail( current_exception() );
+      return;
+    }
+
+    decoded_frames_.push( move( decoded_frame.get() ) );
+  }
+
+  decoded_frames_.finish();
+}
+
+Optional<DecodeAhead::DecodedFrame> DecodeAhead::next( void )
+{
+  return decoded_frames_.pop();
+}
@@ -0,0 +1,58 @@
+#ifndef DECODE_AHEAD_HH
+#define DECODE_AHEAD_HH
+
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include "player.hh"
+#include "bounded_queue.hh"
+
+/* Decodes a file on its own thread, keeping up to a fixed number of
+   shown frames ready ahead of whoever consumes them, so that a display
+   need not wait on a slow frame and the decoder does not sit idle while
+   the display waits for vsync. */
+class DecodeAhead
+{
+public:
+  struct DecodedFrame
+  {
+    RasterHandle raster;
+    unsigned int frame_no;
+
+    /* how long the decoder took to produce it */
+    std::chrono::nanoseconds decode_latency;
+  };
+
+private:
+  FilePlayer player_;
+
+  /* of the stream's size, for callers to size a display by; the decoding
+     thread owns player_ and replaces its references as it goes */
+  const VP8Raster example_raster_;
+
+  BoundedQueue<DecodedFrame> decoded_frames_;
+
+  std::thread decoder_ {};
+
+  void decode_all( void );
+
+public:
+  /* decoding with thread_count threads (1 = on the decoding thread only) */
+  DecodeAhead( const std::string & filename, const unsigned int depth, const unsigned int thread_count = 1 );
+
+  /* stops the decoder, discarding any frames it decoded ahead */
+  ~DecodeAhead();
+
+  const VP8Raster & example_raster( void ) const { return example_raster_; }
+
+  /* The next shown frame, waiting for it if need be. Returns nothing
+     after the last frame, and rethrows if decoding failed. */
+  Optional<DecodedFrame> next( void );
+
+  /* forbid copying or moving */
+  DecodeAhead( const DecodeAhead & other ) = delete;
+  DecodeAhead & operator=( const DecodeAhead & other ) = delete;
+};
+
+#endif /* DECODE_AHEAD_HH */
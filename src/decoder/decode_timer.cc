@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "decode_timer.hh"
+#include "exception.hh"
+
+using namespace std;
+
+atomic<bool> DecodeTimer::enabled_ { false };
+thread_local DecodeTimer::ThreadTotals DecodeTimer::thread_totals_;
+
+mutex DecodeTimer::threads_mutex_;
+vector<DecodeTimer::ThreadTotals *> DecodeTimer::threads_;
+array<uint64_t, num_decode_stages> DecodeTimer::exited_threads_nanoseconds_ {};
+
+DecodeTimer::ThreadTotals::ThreadTotals()
+{
+  lock_guard<mutex> lock( threads_mutex_ );
+  threads_.push_back( this );
+}
+
+DecodeTimer::ThreadTotals::~ThreadTotals()
+{
+  lock_guard<mutex> lock( threads_mutex_ );
+
+  for ( unsigned int i = 0; i < num_decode_stages; i++ ) {
+    exited_threads_nanoseconds_[ i ] += nanoseconds[ i ].load( memory_order_relaxed );
+  }
+
+  threads_.erase( find( threads_.begin(), threads_.end(), this ) );
+}
+
+void DecodeTimer::reset( void )
+{
+  lock_guard<mutex> lock( threads_mutex_ );
+
+  exited_threads_nanoseconds_.fill( 0 );
+
+  for ( ThreadTotals * totals : threads_ ) {
+    for ( atomic<uint64_t> & total : totals->nanoseconds ) {
+      total.store( 0, memory_order_relaxed );
+    }
+  }
+}
+
+uint64_t DecodeTimer::nanoseconds( const DecodeStage stage )
+{
+  const unsigned int index = static_cast<unsigned int>( stage );
+
+  lock_guard<mutex> lock( threads_mutex_ );
+
+  uint64_t total = exited_threads_nanoseconds_[ index ];
+  for ( const ThreadTotals * totals : threads_ ) {
+    total += totals->nanoseconds[ index ].load( memory_order_relaxed );
+  }
+
+  return total;
+}
+
+const char * DecodeTimer::name( const DecodeStage stage )
+{
+  switch ( stage ) {
+  case DecodeStage::Decompress: return "decompress_frame";
+  case DecodeStage::MacroblockHeaders: return "macroblock_headers";
+  case DecodeStage::Tokens: return "parse_tokens";
+  case DecodeStage::IntraReconstruction: return "intra_reconstruction";
+  case DecodeStage::InterReconstruction: return "inter_reconstruction";
+  case DecodeStage::LoopFilter: return "loop_filter";
+  case DecodeStage::Hashing: return "hashing";
+  default: throw LogicError();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef DECODE_TIMER_HH
+#define DECODE_TIMER_HH
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+enum class DecodeStage : unsigned int
+{
+  Decompress,           /* Decoder::decompress_frame */
+  MacroblockHeaders,    /* Frame::parse_macroblock_headers */
+  Tokens,               /* Frame::parse_tokens */
+  IntraReconstruction,
+  InterReconstruction,
+  LoopFilter,
+  Hashing
+};
+
+constexpr unsigned int num_decode_stages = static_cast<unsigned int>( DecodeStage::Hashing ) + 1;
+
+/* Adds the time between its construction and destruction to a running
+   total for one stage of decoding, summed over all threads. Timing is
+   off until enabled (vp8decode --bench turns it on), and a timer then
+   costs a single relaxed load. Each thread adds to totals of its own,
+   which are merged only when read, so timing adds no contention between
+   the threads being timed. */
+class DecodeTimer
+{
+private:
+  /* written only by the owning thread; on a cache line of its own */
+  struct alignas( 64 ) ThreadTotals
+  {
+    std::array<std::atomic<uint64_t>, num_decode_stages> nanoseconds {};
+
+    ThreadTotals();   /* registers with the threads being summed */
+    ~ThreadTotals();  /* folds the totals into those of exited threads */
+
+    /* forbid copying or moving */
+    ThreadTotals( const ThreadTotals & other ) = delete;
+    ThreadTotals & operator=( const ThreadTotals & other ) = delete;
+  };
+
+  static std::atomic<bool> enabled_;
+  static thread_local ThreadTotals thread_totals_;
+
+  static std::mutex threads_mutex_;
+  static std::vector<ThreadTotals *> threads_;
+  static std::array<uint64_t, num_decode_stages> exited_threads_nanoseconds_;
+
+  const DecodeStage stage_;
+  const bool timing_;
+  const std::chrono::steady_clock::time_point start_;
+
+public:
+  DecodeTimer( const DecodeStage stage )
+    : stage_( stage ),
+      timing_( enabled_.load( std::memory_order_relaxed ) ),
+      start_( timing_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point() )
+  {}
+
+  ~DecodeTimer()
+  {
+    if ( timing_ ) {
+      const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start_;
+      std::atomic<uint64_t> & total = thread_totals_.nanoseconds[ static_cast<unsigned int>( stage_ ) ];
+      total.store( total.load( std::memory_order_relaxed ) + elapsed.count(), std::memory_order_relaxed );
+    }
+  }
+
+  static void enable( const bool enabled ) { enabled_ = enabled; }
+
+  /* zero every stage's total; no timer may be running */
+  static void reset( void );
+
+  /* summed over every thread, including those that have exited */
+  static uint64_t nanoseconds( const DecodeStage stage );
+
+  static const char * name( const DecodeStage stage );
+
+  /* forbid copying or moving */
+  DecodeTimer( const DecodeTimer & other ) = delete;
+  DecodeTimer & operator=( const DecodeTimer & other ) = delete;
+};
+
+#endif /* DECODE_TIMER_HH */
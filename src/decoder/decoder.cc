@@ -2,6 +2,9 @@
 #include "uncompressed_chunk.hh"
 #include "frame.hh"
 #include "decoder_state.hh"
+#include "frame_arena.hh"
+#include "thread_pool.hh"
+#include "decode_timer.hh"
 
 #include <sstream>
 
@@ -9,15 +12,33 @@ using namespace std;
 
 Decoder::Decoder( const uint16_t width, const uint16_t height )
   : state_( width, height ),
-    references_( width, height )
+    references_( width, height ),
+    frame_arena_( make_shared<FrameArena>() )
 {}
 
 Decoder::Decoder( DecoderState state, References refs )
-  : state_( state ), references_( refs )
+  : state_( state ), references_( refs ),
+    frame_arena_( make_shared<FrameArena>() )
 {}
 
+void Decoder::set_thread_count( const unsigned int thread_count )
+{
+  if ( thread_count > 1 ) {
+    thread_pool_ = make_shared<ThreadPool>( thread_count );
+  } else {
+    thread_pool_.reset();
+  }
+}
+
+unsigned int Decoder::thread_count( void ) const
+{
+  return thread_pool_ ? thread_pool_->concurrency() : 1;
+}
+
 UncompressedChunk Decoder::decompress_frame( const Chunk & compressed_frame ) const
 {
+  DecodeTimer timer( DecodeStage::Decompress );
+
   /* parse uncompressed data chunk */
   return UncompressedChunk( compressed_frame, state_.width, state_.height );
 }
@@ -25,7 +46,7 @@ UncompressedChunk Decoder::decompress_frame( const Chunk & compressed_frame ) co
 template<class FrameType>
 FrameType Decoder::parse_frame( const UncompressedChunk & decompressed_frame )
 {
-  return state_.parse_and_apply<FrameType>( decompressed_frame );
+  return state_.parse_and_apply<FrameType>( decompressed_frame, thread_pool_.get(), frame_arena_.get() );
 }
 template KeyFrame Decoder::parse_frame<KeyFrame>( const UncompressedChunk & decompressed_frame );
 template InterFrame Decoder::parse_frame<InterFrame>( const UncompressedChunk & decompressed_frame );
@@ -44,9 +65,11 @@ pair<bool, RasterHandle> Decoder::decode_frame( const FrameType & frame )
 
   const bool shown = frame.show_frame();
 
-  frame.decode( state_.segmentation, references_, raster );
+  frame.decode_and_loopfilter( state_.segmentation, state_.filter_adjustments,
+                               references_, raster, thread_pool_.get() );
 
-  frame.loopfilter( state_.segmentation, state_.filter_adjustments, raster );
+  /* once, so that inter prediction can read past the edges directly */
+  raster.get().extend_borders();
 
   RasterHandle immutable_raster( move( raster ) );
 
@@ -84,6 +107,37 @@ Optional<RasterHandle> Decoder::parse_and_decode_frame( const Chunk & compressed
   return make_optional( output.first, output.second );
 }
 
+template<class FrameType>
+bool Decoder::decode_frame_if_referenced( const FrameType & frame )
+{
+  const UpdateTracker updates = frame.get_updated();
+
+  if ( updates.update_last or updates.update_golden or updates.update_alternate ) {
+    decode_frame( frame );
+    return true;
+  }
+
+  /* with nothing to refresh, copy_to never looks at the raster */
+  frame.copy_to( references_.last, references_ );
+  return false;
+}
+
+bool Decoder::skip_frame( const Chunk & compressed_frame )
+{
+  UncompressedChunk decompressed_frame = decompress_frame( compressed_frame );
+  if ( decompressed_frame.key_frame() ) {
+    return decode_frame_if_referenced( parse_frame<KeyFrame>( decompressed_frame ) );
+  } else if ( decompressed_frame.experimental() ) {
+    if ( decompressed_frame.reference_update() ) {
+      return decode_frame_if_referenced( parse_frame<RefUpdateFrame>( decompressed_frame ) );
+    } else {
+      return decode_frame_if_referenced( parse_frame<StateUpdateFrame>( decompressed_frame ) );
+    }
+  } else {
+    return decode_frame_if_referenced( parse_frame<InterFrame>( decompressed_frame ) );
+  }
+}
+
 SourceHash Decoder::source_hash( const DependencyTracker & deps ) const
 {
   using OptHash = Optional<size_t>;
@@ -122,8 +176,15 @@ References::References( const uint16_t width, const uint16_t height )
   : References( MutableRasterHandle( width, height ) )
 {}
 
+/* a recycled raster's border may not match its pixels */
+static MutableRasterHandle && with_extended_borders( MutableRasterHandle && raster )
+{
+  raster.get().extend_borders();
+  return move( raster );
+}
+
 References::References( MutableRasterHandle && raster )
-  : last( move( raster ) ),
+  : last( with_extended_borders( move( raster ) ) ),
     golden( last ),
     alternative_reference( last )
 {}
@@ -149,13 +210,25 @@ bool DecoderState::operator==( const DecoderState & other ) const
     and filter_adjustments == other.filter_adjustments;
 }
 
+DecoderState DecoderState::unshared( void ) const
+{
+  DecoderState ret( *this );
+
+  ret.probability_tables = probability_tables.unshared();
+  if ( segmentation.initialized() ) {
+    ret.segmentation.get().map = segmentation.get().map.unshared();
+  }
+
+  return ret;
+}
+
 size_t DecoderState::hash( void ) const
 {
   size_t hash_val = 0;
 
   boost::hash_combine( hash_val, width );
   boost::hash_combine( hash_val, height );
-  boost::hash_combine( hash_val, probability_tables.hash() );
+  boost::hash_combine( hash_val, probability_tables->hash() );
   if ( segmentation.initialized() ) {
     boost::hash_combine( hash_val, segmentation.get().hash() );
   }
@@ -189,7 +262,7 @@ size_t Segmentation::hash( void ) const
   boost::hash_range( hash_val, segment_filter_adjustments.begin(),
 		       segment_filter_adjustments.end() );
 
-  boost::hash_range( hash_val, map.begin(), map.end() );
+  boost::hash_range( hash_val, map->begin(), map->end() );
 
   return hash_val;
 }
@@ -207,12 +280,3 @@ bool Segmentation::operator==( const Segmentation & other ) const
     and segment_filter_adjustments == other.segment_filter_adjustments
     and map == other.map;
 }
-
-Segmentation::Segmentation( const Segmentation & other )
-  : absolute_segment_adjustments( other.absolute_segment_adjustments ),
-    segment_quantizer_adjustments( other.segment_quantizer_adjustments ),
-    segment_filter_adjustments( other.segment_filter_adjustments ),
-    map( other.map.width(), other.map.height() )
-{
-  map.copy_from( other.map );
-}
@@ -2,7 +2,9 @@
 #define DECODER_HH
 
 #include <vector>
+#include <memory>
 #include "safe_array.hh"
+#include "copy_on_write.hh"
 #include "modemv_data.hh"
 #include "loopfilter.hh"
 #include "vp8_prob_data.hh"
@@ -18,6 +20,8 @@ class VP8Raster;
 struct KeyFrameHeader;
 struct InterFrameHeader;
 class ReferenceDependency;
+class ThreadPool;
+class FrameArena;
 
 struct ProbabilityTables
 {
@@ -77,7 +81,7 @@ struct References
 
   References( MutableRasterHandle && raster );
 
-  const VP8Raster & at( const reference_frame reference_id ) const
+  const RasterHandle & at( const reference_frame reference_id ) const
   {
     switch ( reference_id ) {
     case LAST_FRAME: return last;
@@ -90,6 +94,14 @@ struct References
 
 using SegmentationMap = TwoD< uint8_t >;
 
+template <>
+inline std::shared_ptr<SegmentationMap> CopyOnWrite<SegmentationMap>::duplicate( const SegmentationMap & map )
+{
+  std::shared_ptr<SegmentationMap> ret = std::make_shared<SegmentationMap>( map.width(), map.height() );
+  ret->copy_from( map );
+  return ret;
+}
+
 struct Segmentation
 {
   /* Whether segment-based adjustments are absolute or relative */
@@ -101,29 +113,38 @@ struct Segmentation
   /* Segment-based adjustments to the in-loop deblocking filter */
   SafeArray< int8_t, num_segments > segment_filter_adjustments {{}};
 
-  /* Mapping of macroblocks to segments */
-  SegmentationMap map;
+  /* Mapping of macroblocks to segments, shared until a frame changes it */
+  CopyOnWrite<SegmentationMap> map;
 
   template <class HeaderType>
   Segmentation( const HeaderType & header,
 		const unsigned int width,
 		const unsigned int height );
 
+  /* no adjustments, and the given map */
+  explicit Segmentation( SegmentationMap && s_map ) : map( std::move( s_map ) ) {}
+
   template <class HeaderType>
   void update( const HeaderType & header );
 
   size_t hash( void ) const;
 
   bool operator==( const Segmentation & other ) const;
-
-  Segmentation( const Segmentation & other );
 };
 
+/* How far into a frame parsing goes. The probability tables come out
+   right at any depth, since only the frame header changes them, but the
+   segmentation map is only kept up to date from the macroblock headers
+   on. */
+enum class ParseDepth { Header, MacroblockHeaders, Full };
+
+/* copies share the probability tables and segmentation map, so
+   snapshotting a decoder costs a few reference counts */
 struct DecoderState
 {
   uint16_t width, height;
 
-  ProbabilityTables probability_tables = {};
+  CopyOnWrite<ProbabilityTables> probability_tables = {};
   Optional<Segmentation> segmentation = {};
   Optional<FilterAdjustments> filter_adjustments = {};
 
@@ -133,11 +154,20 @@ struct DecoderState
 		const unsigned int s_width,
 		const unsigned int s_height );
 
+  /* with a thread pool, the DCT partitions are parsed concurrently; with
+     an arena, the frame's arrays are recycled from earlier frames. A
+     frame parsed short of its tokens cannot be decoded. */
   template <class FrameType>
-  FrameType parse_and_apply( const UncompressedChunk & uncompressed_chunk );
+  FrameType parse_and_apply( const UncompressedChunk & uncompressed_chunk,
+			     ThreadPool * const thread_pool = nullptr,
+			     FrameArena * const arena = nullptr,
+			     const ParseDepth depth = ParseDepth::Full );
 
   bool operator==( const DecoderState & other ) const;
 
+  /* a copy sharing nothing with this one, to hand to another thread */
+  DecoderState unshared( void ) const;
+
   Optional<ModeRefLFDeltaUpdate> get_filter_update( void ) const;
   Optional<SegmentFeatureData> get_segment_update( void ) const;
 
@@ -150,10 +180,23 @@ private:
   DecoderState state_;
   References references_;
 
+  /* shared by copies of this decoder; null means decode on the calling thread only */
+  std::shared_ptr<ThreadPool> thread_pool_ {};
+
+  /* also shared by copies, which parse frames of the same size */
+  std::shared_ptr<FrameArena> frame_arena_;
+
+  template<class FrameType>
+  bool decode_frame_if_referenced( const FrameType & frame );
+
 public:
   Decoder( const uint16_t width, const uint16_t height );
   Decoder( DecoderState state, References references );
 
+  /* decode macroblock rows in parallel on this many threads (1 = serial) */
+  void set_thread_count( const unsigned int thread_count );
+  unsigned int thread_count( void ) const;
+
   const VP8Raster & example_raster( void ) const { return references_.last; }
 
   SourceHash source_hash( const DependencyTracker & deps ) const;
@@ -168,9 +211,23 @@ public:
   template<class FrameType>
   std::pair<bool, RasterHandle> decode_frame( const FrameType & frame );
 
+  /* decode a frame parsed elsewhere, taking on the state its parse left behind */
+  template<class FrameType>
+  std::pair<bool, RasterHandle> decode_frame( const FrameType & frame, const DecoderState & parsed_state )
+  {
+    state_ = parsed_state;
+    return decode_frame( frame );
+  }
+
   std::pair<bool, RasterHandle> get_frame_output( const Chunk & compressed_frame );
   Optional<RasterHandle> parse_and_decode_frame( const Chunk & compressed_frame );
 
+  /* Moves the decoder past a frame whose output is not wanted. A frame
+     that refreshes none of the references is parsed (which updates the
+     state) and has its copies between references applied, but is never
+     reconstructed. Returns whether the frame had to be reconstructed. */
+  bool skip_frame( const Chunk & compressed_frame );
+
   template <class FrameType>
   void apply_decoded_frame( const FrameType & frame, const RasterHandle & output, const Decoder & target )
   {
@@ -178,10 +235,20 @@ public:
     frame.copy_to( output, references_ );
   }
 
+  /* take on another decoder's state and references, keeping this
+     decoder's thread pool and frame arena */
+  void restore( const Decoder & saved )
+  {
+    state_ = saved.state_;
+    references_ = saved.references_;
+  }
+
   MissingTracker find_missing( const References & refs, const ReferenceDependency & deps ) const;
 
   DecoderState get_state() const { return state_; }
 
+  const std::shared_ptr<FrameArena> & frame_arena( void ) const { return frame_arena_; }
+
   References get_references( void ) const;
 
   bool operator==( const Decoder & other ) const;
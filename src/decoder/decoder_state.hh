@@ -36,7 +36,10 @@ void FilterAdjustments::update( const HeaderType & header ) {
 }
 
 template <>
-inline KeyFrame DecoderState::parse_and_apply<KeyFrame>( const UncompressedChunk & uncompressed_chunk )
+inline KeyFrame DecoderState::parse_and_apply<KeyFrame>( const UncompressedChunk & uncompressed_chunk,
+							 ThreadPool * const thread_pool,
+							 FrameArena * const arena,
+							 const ParseDepth depth )
 {
   assert( uncompressed_chunk.key_frame() );
 
@@ -49,33 +52,44 @@ inline KeyFrame DecoderState::parse_and_apply<KeyFrame>( const UncompressedChunk
 
   /* parse keyframe header */
   KeyFrame myframe( uncompressed_chunk.show_frame(),
-		    width, height, first_partition );
+		    width, height, first_partition, arena );
 
   /* reset persistent decoder state to default values */
   *this = DecoderState( myframe.header(), width, height );
 
   /* calculate new probability tables. replace persistent copy if prescribed in header */
-  ProbabilityTables frame_probability_tables( probability_tables );
-  frame_probability_tables.coeff_prob_update( myframe.header() );
+  CopyOnWrite<ProbabilityTables> frame_probability_tables( probability_tables );
+  frame_probability_tables.mutate().coeff_prob_update( myframe.header() );
   if ( myframe.header().refresh_entropy_probs ) {
     probability_tables = frame_probability_tables;
   }
 
+  if ( depth == ParseDepth::Header ) {
+    return myframe;
+  }
+
   /* parse the frame (and update the persistent segmentation map) */
-  myframe.parse_macroblock_headers( first_partition, frame_probability_tables );
+  myframe.parse_macroblock_headers( first_partition, frame_probability_tables, arena );
 
   if ( segmentation.initialized() ) {
     myframe.update_segmentation( segmentation.get().map );
   }
 
+  if ( depth == ParseDepth::MacroblockHeaders ) {
+    return myframe;
+  }
+
   myframe.parse_tokens( uncompressed_chunk.dct_partitions( myframe.dct_partition_count() ),
-			frame_probability_tables );
+			frame_probability_tables, thread_pool );
 
   return myframe;
 }
 
 template <>
-inline InterFrame DecoderState::parse_and_apply<InterFrame>( const UncompressedChunk & uncompressed_chunk )
+inline InterFrame DecoderState::parse_and_apply<InterFrame>( const UncompressedChunk & uncompressed_chunk,
+							     ThreadPool * const thread_pool,
+							     FrameArena * const arena,
+							     const ParseDepth depth )
 {
   assert( not uncompressed_chunk.key_frame() );
 
@@ -84,11 +98,11 @@ inline InterFrame DecoderState::parse_and_apply<InterFrame>( const UncompressedC
 
   /* parse interframe header */
   InterFrame myframe( uncompressed_chunk.show_frame(),
-		      width, height, first_partition );
+		      width, height, first_partition, arena );
 
   /* update probability tables. replace persistent copy if prescribed in header */
-  ProbabilityTables frame_probability_tables( probability_tables );
-  frame_probability_tables.update( myframe.header() );
+  CopyOnWrite<ProbabilityTables> frame_probability_tables( probability_tables );
+  frame_probability_tables.mutate().update( myframe.header() );
   if ( myframe.header().refresh_entropy_probs ) {
     probability_tables = frame_probability_tables;
   }
@@ -115,21 +129,32 @@ inline InterFrame DecoderState::parse_and_apply<InterFrame>( const UncompressedC
     segmentation.clear();
   }
 
+  if ( depth == ParseDepth::Header ) {
+    return myframe;
+  }
+
   /* parse the frame (and update the persistent segmentation map) */
-  myframe.parse_macroblock_headers( first_partition, frame_probability_tables );
+  myframe.parse_macroblock_headers( first_partition, frame_probability_tables, arena );
 
   if ( segmentation.initialized() ) {
     myframe.update_segmentation( segmentation.get().map );
   }
 
+  if ( depth == ParseDepth::MacroblockHeaders ) {
+    return myframe;
+  }
+
   myframe.parse_tokens( uncompressed_chunk.dct_partitions( myframe.dct_partition_count() ),
-			frame_probability_tables );
+			frame_probability_tables, thread_pool );
 
   return myframe;
 }
 
 template <>
-inline StateUpdateFrame DecoderState::parse_and_apply<StateUpdateFrame>( const UncompressedChunk & uncompressed_chunk )
+inline StateUpdateFrame DecoderState::parse_and_apply<StateUpdateFrame>( const UncompressedChunk & uncompressed_chunk,
+									 ThreadPool * const,
+									 FrameArena * const,
+									 const ParseDepth )
 {
   assert( not uncompressed_chunk.key_frame() );
 
@@ -139,28 +164,39 @@ inline StateUpdateFrame DecoderState::parse_and_apply<StateUpdateFrame>( const U
   /* parse interframe header */
   StateUpdateFrame myframe( false, width, height, first_partition );
 
-  probability_tables.update( myframe.header() );
+  probability_tables.mutate().update( myframe.header() );
 
   return myframe;
 }
 
 template <>
-inline RefUpdateFrame DecoderState::parse_and_apply<RefUpdateFrame>( const UncompressedChunk & uncompressed_chunk )
+inline RefUpdateFrame DecoderState::parse_and_apply<RefUpdateFrame>( const UncompressedChunk & uncompressed_chunk,
+								     ThreadPool * const thread_pool,
+							     FrameArena * const arena,
+							     const ParseDepth depth )
 {
   assert( not uncompressed_chunk.key_frame() );
 
   BoolDecoder first_partition( uncompressed_chunk.first_partition() );
 
-  RefUpdateFrame myframe( false, width, height, first_partition );
+  RefUpdateFrame myframe( false, width, height, first_partition, arena );
 
   ProbabilityTables frame_probability_tables( probability_tables );
   frame_probability_tables.coeff_prob_update( myframe.header() );
 
+  if ( depth == ParseDepth::Header ) {
+    return myframe;
+  }
+
   /* parse the frame */
-  myframe.parse_macroblock_headers( first_partition, frame_probability_tables );
+  myframe.parse_macroblock_headers( first_partition, frame_probability_tables, arena );
+
+  if ( depth == ParseDepth::MacroblockHeaders ) {
+    return myframe;
+  }
 
   myframe.parse_tokens( uncompressed_chunk.dct_partitions( myframe.dct_partition_count() ),
-			frame_probability_tables );
+			frame_probability_tables, thread_pool );
 
   return myframe;
 }
@@ -169,7 +205,7 @@ template <class HeaderType>
 Segmentation::Segmentation( const HeaderType & header,
 			    const unsigned int width,
 			    const unsigned int height )
-  : map( width, height, 3 )
+  : map( SegmentationMap( width, height, 3 ) )
 {
   update( header );
 }
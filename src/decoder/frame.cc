@@ -1,4 +1,7 @@
 #include "frame.hh"
+#include "frame_arena.hh"
+#include "wavefront.hh"
+#include "decode_timer.hh"
 
 using namespace std;
 
@@ -57,10 +60,15 @@ template <class FrameHeaderType, class MacroblockType>
 Frame<FrameHeaderType, MacroblockType>::Frame( const bool show,
 					       const unsigned int width,
 					       const unsigned int height,
-					       BoolDecoder & first_partition )
+					       BoolDecoder & first_partition,
+					       FrameArena * const arena )
   : show_( show ),
     display_width_( width ),
     display_height_( height ),
+    Y2_( FrameArena::make_blocks<Y2Block>( arena, macroblock_width_, macroblock_height_ ) ),
+    Y_( FrameArena::make_blocks<YBlock>( arena, 4 * macroblock_width_, 4 * macroblock_height_ ) ),
+    U_( FrameArena::make_blocks<UVBlock>( arena, 2 * macroblock_width_, 2 * macroblock_height_ ) ),
+    V_( FrameArena::make_blocks<UVBlock>( arena, 2 * macroblock_width_, 2 * macroblock_height_ ) ),
     header_( first_partition ),
     ref_updates_( calculate_updates( header_ ) )
 {}
@@ -116,103 +124,185 @@ DependencyTracker InterFrame::get_used( void ) const
 
 template <class FrameHeaderType, class MacroblockType>
 void Frame<FrameHeaderType, MacroblockType>::parse_macroblock_headers( BoolDecoder & rest_of_first_partition,
-								       const ProbabilityTables & probability_tables )
+								       const ProbabilityTables & probability_tables,
+								       FrameArena * const arena )
 {
+  DecodeTimer timer( DecodeStage::MacroblockHeaders );
+
   /* calculate segment tree probabilities if map is updated by this frame */
   const ProbabilityArray< num_segments > mb_segment_tree_probs = calculate_mb_segment_tree_probs();
 
   /* parse the macroblock headers */
-  macroblock_headers_.initialize( macroblock_width_, macroblock_height_,
-				  rest_of_first_partition, header_,
-				  mb_segment_tree_probs,
-				  probability_tables,
-				  Y2_, Y_, U_, V_ );
+  macroblock_headers_.initialize( FrameArena::make_macroblocks<MacroblockType>( arena, macroblock_width_, macroblock_height_,
+										rest_of_first_partition, header_,
+										mb_segment_tree_probs,
+										probability_tables,
+										Y2_, Y_, U_, V_ ) );
 
   /* repoint Y2 above/left pointers to skip missing subblocks */
   relink_y2_blocks();
 }
 
 template <class FrameHeaderType, class MacroblockType>
-void Frame<FrameHeaderType, MacroblockType>::update_segmentation( SegmentationMap & mutable_segmentation_map )
+void Frame<FrameHeaderType, MacroblockType>::update_segmentation( CopyOnWrite<SegmentationMap> & segmentation_map )
 {
-  macroblock_headers_.get().forall( [&] ( MacroblockType & mb ) { mb.update_segmentation( mutable_segmentation_map ); } );
+  /* only take a private copy of the map if this frame writes to it */
+  if ( header_.update_segmentation.initialized()
+       and header_.update_segmentation.get().update_mb_segmentation_map ) {
+    SegmentationMap & mutable_segmentation_map = segmentation_map.mutate();
+    macroblock_headers_.get().forall( [&] ( MacroblockType & mb ) { mb.update_segmentation( mutable_segmentation_map ); } );
+  } else {
+    const SegmentationMap & constant_segmentation_map = segmentation_map;
+    macroblock_headers_.get().forall( [&] ( MacroblockType & mb ) { mb.read_segmentation( constant_segmentation_map ); } );
+  }
 }
 
 template <class FrameHeaderType, class MacroblockType>
 void Frame<FrameHeaderType, MacroblockType>::parse_tokens( vector< Chunk > dct_partitions,
-							   const ProbabilityTables & probability_tables )
+							   const ProbabilityTables & probability_tables,
+							   ThreadPool * const thread_pool )
 {
+  DecodeTimer timer( DecodeStage::Tokens );
+
   vector<BoolDecoder> dct_partition_decoders;
   for ( const auto & x : dct_partitions ) {
     dct_partition_decoders.emplace_back( x );
   }
 
-  /* parse every macroblock's tokens */
-  macroblock_headers_.get().forall_ij( [&]( MacroblockType & macroblock,
-					    const unsigned int,
-					    const unsigned int row )
-				       {
-					 macroblock.parse_tokens( dct_partition_decoders.at( row % dct_partition_decoders.size() ),
-								  probability_tables ); } );
+  const unsigned int partitions = dct_partition_decoders.size();
+  const unsigned int width = macroblock_headers_.get().width(), height = macroblock_headers_.get().height();
+
+  if ( thread_pool == nullptr or thread_pool->concurrency() == 1 or partitions == 1 or height == 1 ) {
+    /* parse every macroblock's tokens */
+    macroblock_headers_.get().forall_ij( [&]( MacroblockType & macroblock,
+					      const unsigned int,
+					      const unsigned int row )
+					 {
+					   macroblock.parse_tokens( dct_partition_decoders.at( row % partitions ),
+								    probability_tables ); } );
+    return;
+  }
+
+  /* Each partition is its own bool decoder, so partitions can be parsed
+     side by side. The only context shared across rows is the "has
+     nonzero" flag of the block above (Y2 may look further up, but that
+     row is finished before the one in between), so a row may parse
+     column c once the row above has parsed it. All the rows of one
+     partition stay on one thread, in order. */
+  const unsigned int threads = min( thread_pool->concurrency(), partitions );
+
+  RowProgress progress( height );
+
+  thread_pool->run( [&] ( const unsigned int thread_index ) {
+      if ( thread_index >= threads ) {
+	return;
+      }
+
+      try {
+	for ( unsigned int row = 0; row < height; row++ ) {
+	  if ( (row % partitions) % threads != thread_index ) {
+	    continue;
+	  }
+
+	  BoolDecoder & data = dct_partition_decoders.at( row % partitions );
+
+	  for ( unsigned int column = 0; column < width; column++ ) {
+	    if ( row > 0 and not progress.wait( row - 1, column + 1 ) ) {
+	      return;
+	    }
+
+	    macroblock_headers_.get().at( column, row ).parse_tokens( data, probability_tables );
+	    progress.publish( row, column + 1 );
+	  }
+	}
+      } catch ( ... ) {
+	progress.abort();
+	throw;
+      }
+    } );
+}
+
+template <class FrameHeaderType, class MacroblockType>
+SafeArray<FilterParameters, num_segments> Frame<FrameHeaderType, MacroblockType>::calculate_segment_loopfilters( const Optional< Segmentation > & segmentation ) const
+{
+  /* calculate per-segment filter adjustments if
+     segmentation is enabled */
+
+  SafeArray< FilterParameters, num_segments > segment_loopfilters;
+
+  if ( segmentation.initialized() ) {
+    for ( uint8_t i = 0; i < num_segments; i++ ) {
+      FilterParameters segment_filter( header_.filter_type,
+				       header_.loop_filter_level,
+				       header_.sharpness_level );
+      segment_filter.filter_level = segmentation.get().segment_filter_adjustments.at( i )
+	+ ( segmentation.get().absolute_segment_adjustments
+	    ? 0
+	    : segment_filter.filter_level );
+
+      segment_loopfilters.at( i ) = segment_filter;
+    }
+  }
+
+  return segment_loopfilters;
 }
 
 template <class FrameHeaderType, class MacroblockType>
 void Frame<FrameHeaderType, MacroblockType>::loopfilter( const Optional< Segmentation > & segmentation,
 							 const Optional< FilterAdjustments > & filter_adjustments,
-							 VP8Raster & raster ) const
+							 VP8Raster & raster, ThreadPool * const thread_pool ) const
 {
   if ( header_.loop_filter_level ) {
-    /* calculate per-segment filter adjustments if
-       segmentation is enabled */
-
     const FilterParameters frame_loopfilter( header_.filter_type,
 					     header_.loop_filter_level,
 					     header_.sharpness_level );
-
-    SafeArray< FilterParameters, num_segments > segment_loopfilters;
-
-    if ( segmentation.initialized() ) {
-      for ( uint8_t i = 0; i < num_segments; i++ ) {
-	FilterParameters segment_filter( header_.filter_type,
-					 header_.loop_filter_level,
-					 header_.sharpness_level );
-	segment_filter.filter_level = segmentation.get().segment_filter_adjustments.at( i )
-	  + ( segmentation.get().absolute_segment_adjustments
-	      ? 0
-	      : segment_filter.filter_level );
-
-	segment_loopfilters.at( i ) = segment_filter;
-      }
-    }
+    const auto segment_loopfilters = calculate_segment_loopfilters( segmentation );
 
     /* the macroblock needs to know whether the mode- and reference-based
        filter adjustments are enabled */
 
-    macroblock_headers_.get().forall_ij( [&]( const MacroblockType & macroblock,
-					      const unsigned int column,
-					      const unsigned int row )
-					 { macroblock.loopfilter( filter_adjustments,
-								  segmentation.initialized()
-								  ? segment_loopfilters.at( macroblock.segment_id() )
-								  : frame_loopfilter,
-								  raster.macroblock( column, row ) ); } );
+    /* Filtering a macroblock rewrites the right edge of its left
+       neighbour and the bottom edge of its upper neighbour, so the
+       macroblock above and to the right must be filtered first. That is
+       the ordering the wavefront already keeps for reconstruction. */
+    wavefront_forall_ij( macroblock_headers_.get(), thread_pool,
+			 [&]( const MacroblockType & macroblock,
+			      const unsigned int column,
+			      const unsigned int row )
+			 { VP8Raster::MacroblockPixels raster_macroblock = raster.macroblock_pixels( column, row );
+			   macroblock.loopfilter( filter_adjustments,
+						  segmentation.initialized()
+						  ? segment_loopfilters.at( macroblock.segment_id() )
+						  : frame_loopfilter,
+						  raster_macroblock ); } );
   }
 }
 
-
 // FIXME probably want to subclass so we don't need to specialize all these nops
 template <>
 void RefUpdateFrame::loopfilter( const Optional<Segmentation> &,
 			         const Optional<FilterAdjustments> &,
-				 VP8Raster & ) const
+				 VP8Raster &, ThreadPool * const ) const
 {}
 
 template <>
 void StateUpdateFrame::loopfilter( const Optional<Segmentation> &,
 			           const Optional<FilterAdjustments> &,
-				   VP8Raster & ) const
+				   VP8Raster &, ThreadPool * const ) const
 {}
 
+template <>
+SafeArray<FilterParameters, num_segments> RefUpdateFrame::calculate_segment_loopfilters( const Optional< Segmentation > & ) const
+{
+  return SafeArray<FilterParameters, num_segments>();
+}
+
+template <>
+SafeArray<FilterParameters, num_segments> StateUpdateFrame::calculate_segment_loopfilters( const Optional< Segmentation > & ) const
+{
+  return SafeArray<FilterParameters, num_segments>();
+}
+
 
 template <class FrameHeaderType, class MacroblockType>
 SafeArray<Quantizer, num_segments> Frame<FrameHeaderType, MacroblockType>::calculate_segment_quantizers( const Optional< Segmentation > & segmentation ) const
@@ -250,51 +340,100 @@ SafeArray<Quantizer, num_segments> StateUpdateFrame::calculate_segment_quantizer
 }
 
 template <>
-void KeyFrame::decode( const Optional< Segmentation > & segmentation, const References &,
-                       VP8Raster & raster ) const
+void KeyFrame::reconstruct_macroblock( const KeyFrameMacroblock & macroblock, const Quantizer & quantizer,
+				       const References &, VP8Raster::Macroblock & raster ) const
+{
+  DecodeTimer timer( DecodeStage::IntraReconstruction );
+  macroblock.reconstruct_intra( quantizer, raster );
+}
+
+template <>
+void InterFrame::reconstruct_macroblock( const InterFrameMacroblock & macroblock, const Quantizer & quantizer,
+					 const References & references, VP8Raster::Macroblock & raster ) const
+{
+  if ( macroblock.inter_coded() ) {
+    DecodeTimer timer( DecodeStage::InterReconstruction );
+    macroblock.reconstruct_inter( quantizer, references, raster );
+  } else {
+    DecodeTimer timer( DecodeStage::IntraReconstruction );
+    macroblock.reconstruct_intra( quantizer, raster );
+  }
+}
+
+template <class FrameHeaderType, class MacroblockType>
+void Frame<FrameHeaderType, MacroblockType>::decode( const Optional< Segmentation > & segmentation,
+						     const References & references,
+						     VP8Raster & raster, ThreadPool * const thread_pool ) const
 {
   const Quantizer frame_quantizer( header_.quant_indices );
   const auto segment_quantizers = calculate_segment_quantizers( segmentation );
 
   /* process each macroblock */
-  macroblock_headers_.get().forall_ij( [&]( const KeyFrameMacroblock & macroblock,
-					    const unsigned int column,
-					    const unsigned int row ) {
-					 const auto & quantizer = segmentation.initialized()
-					   ? segment_quantizers.at( macroblock.segment_id() )
-					   : frame_quantizer;
-					 macroblock.reconstruct_intra( quantizer,
-								       raster.macroblock( column, row ) );
-				       } );
+  wavefront_forall_ij( macroblock_headers_.get(), thread_pool,
+		       [&]( const MacroblockType & macroblock,
+			    const unsigned int column,
+			    const unsigned int row ) {
+			 VP8Raster::Macroblock raster_macroblock = raster.macroblock( column, row );
+			 reconstruct_macroblock( macroblock,
+						 segmentation.initialized()
+						 ? segment_quantizers.at( macroblock.segment_id() )
+						 : frame_quantizer,
+						 references,
+						 raster_macroblock );
+		       } );
 }
 
-template <>
-void InterFrame::decode( const Optional<Segmentation> & segmentation, const References & references,
-                         VP8Raster & raster ) const
+template <class FrameHeaderType, class MacroblockType>
+void Frame<FrameHeaderType, MacroblockType>::decode_and_loopfilter( const Optional< Segmentation > & segmentation,
+								    const Optional< FilterAdjustments > & filter_adjustments,
+								    const References & references,
+								    VP8Raster & raster, ThreadPool * const thread_pool ) const
 {
+  if ( not header_.loop_filter_level ) {
+    decode( segmentation, references, raster, thread_pool );
+    return;
+  }
+
   const Quantizer frame_quantizer( header_.quant_indices );
   const auto segment_quantizers = calculate_segment_quantizers( segmentation );
 
-  /* process each macroblock */
-  macroblock_headers_.get().forall_ij( [&]( const InterFrameMacroblock & macroblock,
-					    const unsigned int column,
-					    const unsigned int row ) {
-					 const auto & quantizer = segmentation.initialized()
-					   ? segment_quantizers.at( macroblock.segment_id() )
-					   : frame_quantizer;
-					 if ( macroblock.inter_coded() ) {
-					   macroblock.reconstruct_inter( quantizer,
-					                                 references,
-					                                 raster.macroblock( column, row ) );
-					 } else {
-					   macroblock.reconstruct_intra( quantizer,
-									 raster.macroblock( column, row ) );
-					 } } );
+  const FilterParameters frame_loopfilter( header_.filter_type,
+					   header_.loop_filter_level,
+					   header_.sharpness_level );
+  const auto segment_loopfilters = calculate_segment_loopfilters( segmentation );
+
+  /* Filtering a macroblock changes the bottom rows of the one above it
+     and its own pixels, but intra prediction only reads the bottom row
+     and right column of its neighbours. Filtering a row once the row
+     below has been reconstructed past it therefore never hands
+     prediction a filtered pixel, and no unfiltered copy is needed. */
+  lagged_wavefront_forall_ij( macroblock_headers_.get(), thread_pool,
+			      [&]( const MacroblockType & macroblock,
+				   const unsigned int column,
+				   const unsigned int row ) {
+				VP8Raster::Macroblock raster_macroblock = raster.macroblock( column, row );
+				reconstruct_macroblock( macroblock,
+							segmentation.initialized()
+							? segment_quantizers.at( macroblock.segment_id() )
+							: frame_quantizer,
+							references,
+							raster_macroblock );
+			      },
+			      [&]( const MacroblockType & macroblock,
+				   const unsigned int column,
+				   const unsigned int row ) {
+				VP8Raster::MacroblockPixels raster_macroblock = raster.macroblock_pixels( column, row );
+				macroblock.loopfilter( filter_adjustments,
+						       segmentation.initialized()
+						       ? segment_loopfilters.at( macroblock.segment_id() )
+						       : frame_loopfilter,
+						       raster_macroblock );
+			      } );
 }
 
 template <>
 void RefUpdateFrame::decode( const Optional<Segmentation> &, const References & references,
-                             VP8Raster & raster ) const
+                             VP8Raster & raster, ThreadPool * const ) const
 {
   /* RefUpdateFrames only depend on one reference (the one they are updating) */
   const VP8Raster & reference = references.at( header_.reference() );
@@ -302,13 +441,32 @@ void RefUpdateFrame::decode( const Optional<Segmentation> &, const References &
   macroblock_headers_.get().forall_ij( [&]( const RefUpdateFrameMacroblock & macroblock,
                                             const unsigned column,
                                             const unsigned row ) {
-                                         macroblock.reconstruct_continuation( reference, raster.macroblock( column, row ) );
+                                         VP8Raster::Macroblock raster_macroblock = raster.macroblock( column, row );
+                                         macroblock.reconstruct_continuation( reference, raster_macroblock );
                                        } );
 }
 
 template <>
 void StateUpdateFrame::decode( const Optional<Segmentation> &, const References &,
-                               VP8Raster & ) const
+                               VP8Raster &, ThreadPool * const ) const
+{
+}
+
+/* neither of these has a loop filter to run */
+template <>
+void RefUpdateFrame::decode_and_loopfilter( const Optional<Segmentation> & segmentation,
+					    const Optional<FilterAdjustments> &,
+					    const References & references,
+					    VP8Raster & raster, ThreadPool * const thread_pool ) const
+{
+  decode( segmentation, references, raster, thread_pool );
+}
+
+template <>
+void StateUpdateFrame::decode_and_loopfilter( const Optional<Segmentation> &,
+					      const Optional<FilterAdjustments> &,
+					      const References &,
+					      VP8Raster &, ThreadPool * const ) const
 {
 }
 
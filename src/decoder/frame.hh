@@ -11,6 +11,8 @@ struct Segmentation;
 struct FilterAdjustments;
 
 class ReferenceDependency;
+class ThreadPool;
+class FrameArena;
 
 struct Quantizers
 {
@@ -41,20 +43,27 @@ class Frame
 
   ProbabilityArray< num_segments > calculate_mb_segment_tree_probs( void ) const;
   SafeArray< Quantizer, num_segments > calculate_segment_quantizers( const Optional< Segmentation > & segmentation ) const;
+  SafeArray< FilterParameters, num_segments > calculate_segment_loopfilters( const Optional< Segmentation > & segmentation ) const;
+
+  void reconstruct_macroblock( const MacroblockType & macroblock, const Quantizer & quantizer,
+			       const References & references, VP8Raster::Macroblock & raster ) const;
 
   std::vector< uint8_t > serialize_first_partition( const ProbabilityTables & probability_tables ) const;
   std::vector< std::vector< uint8_t > > serialize_tokens( const ProbabilityTables & probability_tables ) const;
 
  public:
   void relink_y2_blocks( void );
+  /* with a thread pool, macroblock rows are filtered as a wavefront */
   void loopfilter( const Optional< Segmentation > & segmentation,
 		   const Optional< FilterAdjustments > & quantizer_filter_adjustments,
-		   VP8Raster & target ) const;
+		   VP8Raster & target, ThreadPool * const thread_pool = nullptr ) const;
 
+  /* with an arena, the block arrays are recycled from earlier frames */
   Frame( const bool show,
 	 const unsigned int width,
 	 const unsigned int height,
-	 BoolDecoder & first_partition );
+	 BoolDecoder & first_partition,
+	 FrameArena * const arena = nullptr );
 
   /* Construct a StateUpdateFrame */
   Frame( const ProbabilityTables & source_probs,
@@ -78,14 +87,25 @@ class Frame
   TwoD<MacroblockType> & mutable_macroblocks() { return macroblock_headers_.get(); }
 
   void parse_macroblock_headers( BoolDecoder & rest_of_first_partition,
-				 const ProbabilityTables & probability_tables );
+				 const ProbabilityTables & probability_tables,
+				 FrameArena * const arena = nullptr );
 
-  void update_segmentation( SegmentationMap & mutable_segmentation_map );
+  void update_segmentation( CopyOnWrite<SegmentationMap> & segmentation_map );
 
-  void parse_tokens( std::vector< Chunk > dct_partitions, const ProbabilityTables & probability_tables );
+  /* with a thread pool, the DCT partitions are parsed concurrently */
+  void parse_tokens( std::vector< Chunk > dct_partitions, const ProbabilityTables & probability_tables,
+                     ThreadPool * const thread_pool = nullptr );
 
+  /* with a thread pool, macroblock rows are reconstructed as a wavefront */
   void decode( const Optional< Segmentation > & segmentation, const References & references,
-               VP8Raster & raster ) const;
+               VP8Raster & raster, ThreadPool * const thread_pool = nullptr ) const;
+
+  /* decode() and loopfilter() in a single pass, filtering each row as
+     soon as the row below it is reconstructed */
+  void decode_and_loopfilter( const Optional< Segmentation > & segmentation,
+			      const Optional< FilterAdjustments > & filter_adjustments,
+			      const References & references,
+			      VP8Raster & raster, ThreadPool * const thread_pool = nullptr ) const;
 
   void copy_to( const RasterHandle & raster, References & references ) const;
 
@@ -150,8 +170,8 @@ private:
   uint8_t prob_skip_;
   unsigned width_, height_;
 public:
-  ReferenceUpdater( const reference_frame & ref_frame, const VP8Raster & current,
-                    const VP8Raster & target, const ReferenceDependency & dependencies );
+  ReferenceUpdater( const reference_frame & ref_frame, const RasterHandle & current,
+                    const RasterHandle & target, const ReferenceDependency & dependencies );
 
   Optional<ReferenceUpdater::MacroblockDiff> macroblock( const unsigned int column, const unsigned int row ) const;
 
@@ -0,0 +1,162 @@
+#ifndef FRAME_ARENA_HH
+#define FRAME_ARENA_HH
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "2d.hh"
+#include "block.hh"
+#include "macroblock.hh"
+
+/* Recycles the arrays a Frame parses into (its blocks and macroblock
+   headers) between the frames of a decoder and its copies. An array
+   comes back here when the last frame using it is destroyed, on any
+   thread, and goes to the next frame of the same size. */
+class FrameArena : public std::enable_shared_from_this<FrameArena>
+{
+public:
+  struct Statistics
+  {
+    uint64_t allocations, reuses;
+  };
+
+private:
+  template <class T>
+  struct Shelf
+  {
+    std::mutex mutex {};
+    std::vector< std::unique_ptr< TwoDStorage<T> > > arrays {};
+  };
+
+  /* enough for the frames a decoder has in flight at once */
+  static constexpr unsigned int shelf_limit = 4;
+
+  Shelf<Y2Block> Y2_ {};
+  Shelf<YBlock> Y_ {};
+  Shelf<UVBlock> UV_ {};
+  Shelf<KeyFrameMacroblock> key_frame_macroblocks_ {};
+  Shelf<InterFrameMacroblock> inter_frame_macroblocks_ {};
+
+  std::atomic<uint64_t> allocations_ { 0 }, reuses_ { 0 };
+
+  /* nullptr for types that are not recycled */
+  template <class T>
+  Shelf<T> * shelf( void ) { return nullptr; }
+
+  template <class T>
+  std::unique_ptr< TwoDStorage<T> > take( Shelf<T> & shelf, const unsigned int width, const unsigned int height )
+  {
+    std::unique_lock<std::mutex> lock { shelf.mutex };
+
+    for ( auto it = shelf.arrays.begin(); it != shelf.arrays.end(); it++ ) {
+      if ( (*it)->width() == width and (*it)->height() == height ) {
+        std::unique_ptr< TwoDStorage<T> > ret = std::move( *it );
+        shelf.arrays.erase( it );
+        reuses_++;
+        return ret;
+      }
+    }
+
+    allocations_++;
+    return nullptr;
+  }
+
+  template <class T>
+  void give_back( Shelf<T> & shelf, TwoDStorage<T> * const array )
+  {
+    std::unique_ptr< TwoDStorage<T> > owned { array };
+
+    std::unique_lock<std::mutex> lock { shelf.mutex };
+
+    if ( shelf.arrays.size() < shelf_limit ) {
+      shelf.arrays.push_back( std::move( owned ) );
+    }
+  }
+
+  /* the array returns to the shelf when the TwoD and its moves are gone */
+  template <class T>
+  TwoD<T> lend( Shelf<T> & shelf, std::unique_ptr< TwoDStorage<T> > && array )
+  {
+    const std::shared_ptr<FrameArena> self = shared_from_this();
+    Shelf<T> * const shelf_ptr = &shelf;
+
+    return TwoD<T>( std::shared_ptr< TwoDStorage<T> >( array.release(),
+                                                       [self, shelf_ptr] ( TwoDStorage<T> * returned )
+                                                       { self->give_back( *shelf_ptr, returned ); } ) );
+  }
+
+public:
+  FrameArena() {}
+
+  /* an array of blocks as a new frame expects them; without an arena
+     the array is simply allocated */
+  template <class T>
+  static TwoD<T> make_blocks( FrameArena * const arena, const unsigned int width, const unsigned int height )
+  {
+    Shelf<T> * const shelf = arena ? arena->shelf<T>() : nullptr;
+    if ( not shelf ) {
+      return TwoD<T>( width, height );
+    }
+
+    std::unique_ptr< TwoDStorage<T> > array = arena->take( *shelf, width, height );
+    if ( array ) {
+      array->forall( [] ( T & block ) { block.reset(); } );
+    } else {
+      array.reset( new TwoDStorage<T>( width, height ) );
+    }
+
+    return arena->lend( *shelf, std::move( array ) );
+  }
+
+  /* an array of macroblocks, each constructed from Fargs */
+  template <class T, typename... Targs>
+  static TwoD<T> make_macroblocks( FrameArena * const arena, const unsigned int width, const unsigned int height,
+                                   Targs&&... Fargs )
+  {
+    Shelf<T> * const shelf = arena ? arena->shelf<T>() : nullptr;
+    if ( not shelf ) {
+      return TwoD<T>( width, height, std::forward<Targs>( Fargs )... );
+    }
+
+    std::unique_ptr< TwoDStorage<T> > array = arena->take( *shelf, width, height );
+    if ( array ) {
+      array->rebuild( std::forward<Targs>( Fargs )... );
+    } else {
+      array.reset( new TwoDStorage<T>( width, height, std::forward<Targs>( Fargs )... ) );
+    }
+
+    return arena->lend( *shelf, std::move( array ) );
+  }
+
+  /* arrays allocated, and arrays handed out again, since construction */
+  Statistics statistics( void ) const { return { allocations_, reuses_ }; }
+
+  /* forbid copying or moving */
+  FrameArena( const FrameArena & other ) = delete;
+  FrameArena & operator=( const FrameArena & other ) = delete;
+};
+
+template <>
+inline FrameArena::Shelf<Y2Block> * FrameArena::shelf<Y2Block>( void ) { return &Y2_; }
+
+template <>
+inline FrameArena::Shelf<YBlock> * FrameArena::shelf<YBlock>( void ) { return &Y_; }
+
+template <>
+inline FrameArena::Shelf<UVBlock> * FrameArena::shelf<UVBlock>( void ) { return &UV_; }
+
+template <>
+inline FrameArena::Shelf<KeyFrameMacroblock> * FrameArena::shelf<KeyFrameMacroblock>( void )
+{
+  return &key_frame_macroblocks_;
+}
+
+template <>
+inline FrameArena::Shelf<InterFrameMacroblock> * FrameArena::shelf<InterFrameMacroblock>( void )
+{
+  return &inter_frame_macroblocks_;
+}
+
+#endif /* FRAME_ARENA_HH */
@@ -0,0 +1,72 @@
+#include "frame_scanner.hh"
+#include "frame_arena.hh"
+#include "decoder_state.hh"
+#include "uncompressed_chunk.hh"
+
+using namespace std;
+
+FrameScanner::FrameScanner( const uint16_t width, const uint16_t height, const bool macroblock_headers )
+  : state_( width, height ),
+    arena_( make_shared<FrameArena>() ),
+    depth_( macroblock_headers ? ParseDepth::MacroblockHeaders : ParseDepth::Header )
+{}
+
+template <class FrameHeaderType, class MacroblockType>
+void FrameScanner::summarize( Frame<FrameHeaderType, MacroblockType> & frame, FrameSummary & summary ) const
+{
+  summary.y_ac_qi = frame.header().quant_indices.y_ac_qi;
+  summary.loop_filter_level = frame.header().loop_filter_level;
+
+  if ( depth_ == ParseDepth::Header ) {
+    return;
+  }
+
+  frame.mutable_macroblocks().forall(
+    [&] ( MacroblockType & macroblock )
+    {
+      summary.macroblocks_by_reference.at( macroblock.header().reference() )++;
+      summary.y_modes.at( macroblock.y_prediction_mode() )++;
+
+      if ( macroblock.inter_coded() ) {
+        return;
+      }
+
+      summary.uv_modes.at( macroblock.uv_prediction_mode() )++;
+
+      if ( macroblock.y_prediction_mode() == B_PRED ) {
+        macroblock.Y().forall( [&] ( const YBlock & block ) { summary.b_modes.at( block.prediction_mode() )++; } );
+      }
+    } );
+}
+
+FrameSummary FrameScanner::scan( const Chunk & compressed_frame )
+{
+  const UncompressedChunk uncompressed_chunk( compressed_frame, state_.width, state_.height );
+
+  FrameSummary summary;
+  summary.size = compressed_frame.size();
+  summary.first_partition_size = uncompressed_chunk.first_partition().size();
+  summary.key_frame = uncompressed_chunk.key_frame();
+  summary.experimental = uncompressed_chunk.experimental();
+  summary.shown = uncompressed_chunk.show_frame();
+
+  if ( uncompressed_chunk.key_frame() ) {
+    KeyFrame frame = state_.parse_and_apply<KeyFrame>( uncompressed_chunk, nullptr, arena_.get(), depth_ );
+    summary.updates = frame.get_updated();
+    summarize( frame, summary );
+  } else if ( uncompressed_chunk.experimental() ) {
+    /* nothing to count in these */
+    if ( uncompressed_chunk.reference_update() ) {
+      summary.updates = state_.parse_and_apply<RefUpdateFrame>( uncompressed_chunk, nullptr, arena_.get(),
+                                                                ParseDepth::Header ).get_updated();
+    } else {
+      state_.parse_and_apply<StateUpdateFrame>( uncompressed_chunk );
+    }
+  } else {
+    InterFrame frame = state_.parse_and_apply<InterFrame>( uncompressed_chunk, nullptr, arena_.get(), depth_ );
+    summary.updates = frame.get_updated();
+    summarize( frame, summary );
+  }
+
+  return summary;
+}
@@ -0,0 +1,58 @@
+#ifndef FRAME_SCANNER_HH
+#define FRAME_SCANNER_HH
+
+#include <memory>
+
+#include "decoder.hh"
+#include "modemv_data.hh"
+#include "safe_array.hh"
+
+class Chunk;
+class FrameArena;
+
+template <class FrameHeaderType, class MacroblockType>
+class Frame;
+
+/* What the headers of one frame say about it */
+struct FrameSummary
+{
+  uint64_t size { 0 };
+  uint64_t first_partition_size { 0 };
+  bool key_frame { false };
+  bool experimental { false };
+  bool shown { false };
+
+  /* zero for experimental frames, which have neither */
+  uint8_t y_ac_qi { 0 };
+  uint8_t loop_filter_level { 0 };
+
+  UpdateTracker updates { false, false, false, false, false, false, false };
+
+  /* counted only when macroblock headers are scanned */
+  SafeArray<unsigned int, num_reference_frames> macroblocks_by_reference {{}};
+  SafeArray<unsigned int, SPLITMV + 1> y_modes {{}};
+  SafeArray<unsigned int, num_uv_modes> uv_modes {{}};
+  SafeArray<unsigned int, num_intra_b_modes> b_modes {{}};
+};
+
+/* Reads the frame header (and optionally the macroblock headers) of
+   each frame in a stream, in order, keeping just enough decoder state to
+   read the next one. The DCT partitions are never touched and nothing
+   is reconstructed. */
+class FrameScanner
+{
+private:
+  DecoderState state_;
+  std::shared_ptr<FrameArena> arena_;
+  ParseDepth depth_;
+
+  template <class FrameHeaderType, class MacroblockType>
+  void summarize( Frame<FrameHeaderType, MacroblockType> & frame, FrameSummary & summary ) const;
+
+public:
+  FrameScanner( const uint16_t width, const uint16_t height, const bool macroblock_headers );
+
+  FrameSummary scan( const Chunk & compressed_frame );
+};
+
+#endif /* FRAME_SCANNER_HH */
@@ -96,16 +96,16 @@ NormalLoopFilter::NormalLoopFilter( const bool key_frame,
 
 }
 
-void SimpleLoopFilter::filter( VP8Raster::Macroblock & , const bool )
+void SimpleLoopFilter::filter( VP8Raster::MacroblockPixels & , const bool )
 {
   throw Unsupported( "VP8 'simple' in-loop deblocking filter" );
 }
 
 // Corresponds roughly to vp8_loop_filter_mbh_c combined with vp8_loop_filter_row_normal
-void NormalLoopFilter::filter( VP8Raster::Macroblock & raster, const bool skip_subblock_edges )
+void NormalLoopFilter::filter( VP8Raster::MacroblockPixels & raster, const bool skip_subblock_edges )
 {
   /* 1: filter the left inter-macroblock edge */
-  if ( raster.Y.context().left.initialized() ) {
+  if ( raster.column > 0 ) {
     filter_mb_vertical( raster );
   }
 
@@ -115,7 +115,7 @@ void NormalLoopFilter::filter( VP8Raster::Macroblock & raster, const bool skip_s
   }
 
   /* 3: filter the top inter-macroblock edge */
-  if ( raster.Y.context().above.initialized() ) {
+  if ( raster.row > 0 ) {
     filter_mb_horizontal( raster );
   }
 
@@ -129,7 +129,7 @@ void NormalLoopFilter::filter( VP8Raster::Macroblock & raster, const bool skip_s
 template <class BlockType>
 void NormalLoopFilter::filter_mb_vertical_c( BlockType & block )
 {
-  const uint8_t size = BlockType::dimension;
+  const uint8_t size = block.width();
 
   for ( unsigned int row = 0; row < size; row++ ) {
     uint8_t *central = &block.at( 0, row );
@@ -157,7 +157,7 @@ void NormalLoopFilter::filter_mb_vertical_c( BlockType & block )
   }
 }
 
-void NormalLoopFilter::filter_mb_vertical( VP8Raster::Macroblock & raster )
+void NormalLoopFilter::filter_mb_vertical( VP8Raster::MacroblockPixels & raster )
 {
 #ifdef HAVE_SSE2
   uint8_t *y_ptr = &raster.Y.at(0, 0);
@@ -183,7 +183,7 @@ void NormalLoopFilter::filter_mb_vertical( VP8Raster::Macroblock & raster )
 template <class BlockType>
 void NormalLoopFilter::filter_mb_horizontal_c( BlockType & block )
 {
-  const uint8_t size = BlockType::dimension;
+  const uint8_t size = block.width();
 
   const unsigned int stride = block.stride();
 
@@ -217,7 +217,7 @@ void NormalLoopFilter::filter_mb_horizontal_c( BlockType & block )
   }
 }
 
-void NormalLoopFilter::filter_mb_horizontal( VP8Raster::Macroblock & raster )
+void NormalLoopFilter::filter_mb_horizontal( VP8Raster::MacroblockPixels & raster )
 {
 #ifdef HAVE_SSE2
   uint8_t *y_ptr = &raster.Y.at(0, 0);
@@ -243,7 +243,7 @@ void NormalLoopFilter::filter_mb_horizontal( VP8Raster::Macroblock & raster )
 template <class BlockType>
 void NormalLoopFilter::filter_sb_vertical_c( BlockType & block )
 {
-  const uint8_t size = BlockType::dimension;
+  const uint8_t size = block.width();
 
   for ( unsigned int center_column = 4; center_column < size; center_column += 4 ) {
     for ( unsigned int row = 0; row < size; row++ ) {
@@ -273,7 +273,7 @@ void NormalLoopFilter::filter_sb_vertical_c( BlockType & block )
   }
 }
 
-void NormalLoopFilter::filter_sb_vertical( VP8Raster::Macroblock & raster )
+void NormalLoopFilter::filter_sb_vertical( VP8Raster::MacroblockPixels & raster )
 {
 #ifdef HAVE_SSE2
   uint8_t *y_ptr = &raster.Y.at(0, 0);
@@ -305,7 +305,7 @@ void NormalLoopFilter::filter_sb_vertical( VP8Raster::Macroblock & raster )
 template <class BlockType>
 void NormalLoopFilter::filter_sb_horizontal_c( BlockType & block )
 {
-  const uint8_t size = BlockType::dimension;
+  const uint8_t size = block.width();
 
   const unsigned int stride = block.stride();
 
@@ -339,7 +339,7 @@ void NormalLoopFilter::filter_sb_horizontal_c( BlockType & block )
   }
 }
 
-void NormalLoopFilter::filter_sb_horizontal( VP8Raster::Macroblock & raster )
+void NormalLoopFilter::filter_sb_horizontal( VP8Raster::MacroblockPixels & raster )
 {
 #ifdef HAVE_SSE2
   uint8_t *y_ptr = &raster.Y.at(0, 0);
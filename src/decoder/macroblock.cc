@@ -1,5 +1,6 @@
 #include "macroblock.hh"
 #include "scorer.hh"
+#include "decode_timer.hh"
 
 #include "tokens.cc"
 #include "transform.cc"
@@ -67,6 +68,12 @@ void Macroblock<FrameHeaderType, MacroblockHeaderType>::update_segmentation( Seg
   segment_id_ = mutable_segmentation_map.at( context_.column, context_.row );
 }
 
+template <class FrameHeaderType, class MacroblockHeaderType>
+void Macroblock<FrameHeaderType, MacroblockHeaderType>::read_segmentation( const SegmentationMap & segmentation_map ) {
+  assert( not segment_id_update_.initialized() );
+  segment_id_ = segmentation_map.at( context_.column, context_.row );
+}
+
 template <>
 void KeyFrameMacroblock::decode_prediction_modes( BoolDecoder & data,
 						  const ProbabilityTables & )
@@ -526,9 +533,9 @@ void RefUpdateFrameMacroblock::reconstruct_continuation( const VP8Raster & refer
   raster.U.inter_predict( zeromv, reference.U() );
   raster.V.inter_predict( zeromv, reference.V() );
 
-  assert( raster.Y.contents() == reference.macroblock( context_.column, context_.row ).Y.contents() );
-  assert( raster.U.contents() == reference.macroblock( context_.column, context_.row ).U.contents() );
-  assert( raster.V.contents() == reference.macroblock( context_.column, context_.row ).V.contents() );
+  assert( raster.Y.contents() == reference.macroblock_pixels( context_.column, context_.row ).Y );
+  assert( raster.U.contents() == reference.macroblock_pixels( context_.column, context_.row ).U );
+  assert( raster.V.contents() == reference.macroblock_pixels( context_.column, context_.row ).V );
 
   Y_.forall_ij( [&] ( const YBlock & block, const unsigned int column, const unsigned int row )
 		{ block.add_residue( raster.Y_sub.at( column, row ) ); } );
@@ -582,8 +589,10 @@ void InterFrameMacroblock::reconstruct_inter( const Quantizer & quantizer,
 template <class FrameHeaderType, class MacroblockHeaderType>
 void Macroblock<FrameHeaderType, MacroblockHeaderType>::loopfilter( const Optional< FilterAdjustments > & filter_adjustments,
 								    const FilterParameters & loopfilter,
-								    VP8Raster::Macroblock & raster ) const
+								    VP8Raster::MacroblockPixels & raster ) const
 {
+  DecodeTimer timer( DecodeStage::LoopFilter );
+
   const bool skip_subblock_edges = Y2_.coded() and ( not has_nonzero_ );
 
   /* which filter are we using? */
@@ -622,13 +631,13 @@ void Macroblock<FrameHeaderType, MacroblockHeaderType>::loopfilter( const Option
 template <>
 void RefUpdateFrameMacroblock::loopfilter( const Optional< FilterAdjustments > &,
 					   const FilterParameters &,
-					   VP8Raster::Macroblock & ) const
+					   VP8Raster::MacroblockPixels & ) const
 {}
 
 template <>
 void StateUpdateFrameMacroblock::loopfilter( const Optional< FilterAdjustments > &,
 					     const FilterParameters &,
-					     VP8Raster::Macroblock & ) const
+					     VP8Raster::MacroblockPixels & ) const
 {}
 
 reference_frame InterFrameMacroblockHeader::reference( void ) const
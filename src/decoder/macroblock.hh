@@ -76,6 +76,7 @@ public:
             TwoD< UVBlock > & frame_V );
 
   void update_segmentation( SegmentationMap & mutable_segmentation_map );
+  void read_segmentation( const SegmentationMap & segmentation_map );
 
   void parse_tokens( BoolDecoder & data,
 		     const ProbabilityTables & probability_tables );
@@ -91,7 +92,7 @@ public:
 
   void loopfilter( const Optional< FilterAdjustments > & filter_adjustments,
 		   const FilterParameters & loopfilter,
-		   VP8Raster::Macroblock & raster ) const;
+		   VP8Raster::MacroblockPixels & raster ) const;
 
   const MacroblockHeaderType & header( void ) const { return header_; }
   const MotionVector & base_motion_vector( void ) const;
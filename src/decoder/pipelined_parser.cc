@@ -0,0 +1,78 @@
+#include "pipelined_parser.hh"
+#include "uncompressed_chunk.hh"
+#include "decoder_state.hh"
+
+using namespace std;
+
+PipelinedParser::PipelinedParser( vector<Chunk> && chunks, const Decoder & decoder, const unsigned int depth )
+  : chunks_( move( chunks ) ),
+    state_( decoder.get_state().unshared() ),
+    arena_( decoder.frame_arena() ),
+    parsed_frames_( depth )
+{
+  parser_ = thread( [this] () { parse_all(); } );
+}
+
+PipelinedParser::~PipelinedParser()
+{
+  parsed_frames_.shut_down();
+  parser_.join();
+}
+
+template <class FrameType>
+PipelinedParser::ParsedFrame PipelinedParser::parse( const UncompressedChunk & chunk )
+{
+  /* tokens are parsed serially here; the decoder's thread pool is left to reconstruction */
+  const shared_ptr<FrameType> frame = make_shared<FrameType>( state_.parse_and_apply<FrameType>( chunk, nullptr,
+                                                                                                  arena_.get() ) );
+
+  /* the decoding thread gets its own copy, so that this thread can
+     keep mutating state_ in place */
+  return { state_.unshared(), [frame] ( Decoder & decoder, const DecoderState & state )
+                   { return decoder.decode_frame( *frame, state ); } };
+}
+
+void PipelinedParser::parse_all( void )
+{
+  for ( const Chunk & chunk : chunks_ ) {
+    if ( not parsed_frames_.wait_for_room() ) {
+      return;
+    }
+
+    Optional<ParsedFrame> parsed_frame;
+
+    try {
+      const UncompressedChunk uncompressed_chunk( chunk, state_.width, state_.height );
+
+      if ( uncompressed_chunk.key_frame() ) {
+        parsed_frame.initialize( parse<KeyFrame>( uncompressed_chunk ) );
+      } else if ( uncompressed_chunk.experimental() ) {
+        if ( uncompressed_chunk.reference_update() ) {
+          parsed_frame.initialize( parse<RefUpdateFrame>( uncompressed_chunk ) );
+        } else {
+          parsed_frame.initialize( parse<StateUpdateFrame>( uncompressed_chunk ) );
+        }
+      } else {
+        parsed_frame.initialize( parse<InterFrame>( uncompressed_chunk ) );
+      }
+    } catch ( ... ) {
+      parsed_frames_.fail( current_exception() );
+      return;
+    }
+
+    parsed_frames_.push( move( parsed_frame.get() ) );
+  }
+
+  parsed_frames_.finish();
+}
+
+Optional<pair<bool, RasterHandle>> PipelinedParser::decode_next( Decoder & decoder )
+{
+  Optional<ParsedFrame> parsed_frame = parsed_frames_.pop();
+
+  if ( not parsed_frame.initialized() ) {
+    return Optional<pair<bool, RasterHandle>>();
+  }
+
+  return make_optional( true, parsed_frame.get().decode( decoder, parsed_frame.get().state ) );
+}
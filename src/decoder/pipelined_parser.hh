@@ -0,0 +1,61 @@
+#ifndef PIPELINED_PARSER_HH
+#define PIPELINED_PARSER_HH
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+
+#include "chunk.hh"
+#include "decoder.hh"
+#include "bounded_queue.hh"
+
+class FrameArena;
+
+/* Parses a sequence of frames on its own thread, running up to a fixed
+   number of frames ahead of the thread that reconstructs them. Parsing
+   depends only on the DecoderState, which each parsed frame carries
+   with it, so reconstruction and loop filtering of one frame overlap
+   with parsing the headers and tokens of the next. */
+class PipelinedParser
+{
+private:
+  /* a parsed frame, and the decoder state it left behind */
+  struct ParsedFrame
+  {
+    DecoderState state;
+    std::function<std::pair<bool, RasterHandle>( Decoder &, const DecoderState & )> decode;
+  };
+
+  const std::vector<Chunk> chunks_;
+  DecoderState state_;
+  const std::shared_ptr<FrameArena> arena_;
+
+  BoundedQueue<ParsedFrame> parsed_frames_;
+
+  std::thread parser_ {};
+
+  template <class FrameType>
+  ParsedFrame parse( const UncompressedChunk & chunk );
+
+  void parse_all( void );
+
+public:
+  /* parses chunks in order, starting from the decoder's current state */
+  PipelinedParser( std::vector<Chunk> && chunks, const Decoder & decoder, const unsigned int depth );
+
+  /* stops the parser, discarding any frames it parsed ahead */
+  ~PipelinedParser();
+
+  /* Reconstructs the next frame with decoder, which must be the decoder
+     (or a copy of it) that the parser started from, and must decode
+     nothing else meanwhile. Returns nothing after the last frame, and
+     rethrows if that frame failed to parse. */
+  Optional<std::pair<bool, RasterHandle>> decode_next( Decoder & decoder );
+
+  /* forbid copying or moving */
+  PipelinedParser( const PipelinedParser & other ) = delete;
+  PipelinedParser & operator=( const PipelinedParser & other ) = delete;
+};
+
+#endif /* PIPELINED_PARSER_HH */
@@ -3,6 +3,9 @@
 #include "decoder_state.hh"
 
 #include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
 
 using namespace std;
 
@@ -48,6 +51,16 @@ bool FramePlayer::can_decode( const FrameInfo & frame ) const
   return frame.validate_source( decoder_.get_hash() );
 }
 
+void FramePlayer::restore( const DecoderCheckpoint & checkpoint )
+{
+  const DecoderState state = checkpoint.decoder().get_state();
+  if ( state.width != width_ or state.height != height_ ) {
+    throw Invalid( "checkpoint is for a different frame size" );
+  }
+
+  decoder_.restore( checkpoint.decoder() );
+}
+
 const VP8Raster & FramePlayer::example_raster( void ) const
 {
   return decoder_.example_raster();
@@ -74,38 +87,187 @@ ostream& operator<<( ostream & out, const FramePlayer & player)
 }
 
 FilePlayer::FilePlayer( const string & filename )
-  : FilePlayer( filename, IVF( filename ) )
+  : FilePlayer( filename, unique_ptr<IVF>( new IVF( filename ) ), nullptr )
+{}
+
+FilePlayer::FilePlayer( FileDescriptor && input, const string & name )
+  : FilePlayer( name, nullptr, unique_ptr<IVFStream>( new IVFStream( move( input ) ) ) )
 {}
 
-FilePlayer::FilePlayer( const string & filename, IVF && file )
-  : FramePlayer( file.width(), file.height() ),
-    file_ ( move( file ) ),
+FilePlayer::FilePlayer( const string & filename, unique_ptr<IVF> && file, unique_ptr<IVFStream> && stream )
+  : FramePlayer( file ? file->width() : stream->width(), file ? file->height() : stream->height() ),
+    file_( move( file ) ),
+    stream_( move( stream ) ),
     filename_( filename )
 {
-  if ( file_.fourcc() != "VP80" ) {
+  if ( ( file_ ? file_->fourcc() : stream_->fourcc() ) != "VP80" ) {
     throw Unsupported( "not a VP8 file" );
   }
 
   // Start at first KeyFrame
-  while ( frame_no_ < file_.frame_count() ) {
-    UncompressedChunk uncompressed_chunk = decoder_.decompress_frame( file_.frame( frame_no_ ) );
+  while ( not eof() ) {
+    UncompressedChunk uncompressed_chunk = decoder_.decompress_frame( peek_frame() );
     if ( uncompressed_chunk.key_frame() ) {
       break;
     }
-    frame_no_++;
+    get_next_frame();
+  }
+}
+
+const IVF & FilePlayer::file( void ) const
+{
+  if ( not file_ ) {
+    throw Unsupported( "random access to a stream" );
   }
+
+  return *file_;
+}
+
+Chunk FilePlayer::peek_frame( void )
+{
+  return stream_ ? stream_->frame() : file_->frame( frame_no_ );
 }
 
 FrameRawData FilePlayer::get_next_frame( void )
 {
-  pair<uint64_t, uint32_t> frame_location = file_.frame_location( frame_no_ );
-  return { file_.frame( frame_no_++ ), frame_location.first, frame_location.second };
+  if ( stream_ ) {
+    /* valid until the stream reads the frame after */
+    const pair<uint64_t, uint32_t> frame_location = stream_->frame_location();
+    const Chunk chunk = stream_->frame();
+    stream_->pop();
+    frame_no_++;
+    return { chunk, frame_location.first, frame_location.second };
+  }
+
+  pair<uint64_t, uint32_t> frame_location = file_->frame_location( frame_no_ );
+  return { file_->frame( frame_no_++ ), frame_location.first, frame_location.second };
+}
+
+void FilePlayer::set_parse_ahead( const unsigned int frames )
+{
+  /* frames already parsed ahead are dropped, and will be parsed again */
+  parser_.reset();
+  parse_ahead_ = frames;
+
+  if ( frames > 0 ) {
+    vector<Chunk> chunks;
+    for ( unsigned int i = frame_no_; i < file().frame_count(); i++ ) {
+      chunks.push_back( file().frame( i ) );
+    }
+
+    parser_.reset( new PipelinedParser( move( chunks ), decoder_, frames ) );
+  }
+}
+
+Optional<RasterHandle> FilePlayer::decode_parsed_frame( void )
+{
+  Optional<pair<bool, RasterHandle>> output = parser_->decode_next( decoder_ );
+  if ( not output.initialized() ) {
+    throw LogicError();
+  }
+
+  frame_no_++;
+  return make_optional( output.get().first, output.get().second );
+}
+
+/* FNV-1a, which unlike std::hash is the same from one build to the next */
+static uint64_t path_hash( const string & path )
+{
+  uint64_t hash = 14695981039346656037ull;
+  for ( const char c : path ) {
+    hash = ( hash ^ uint8_t( c ) ) * 1099511628211ull;
+  }
+  return hash;
+}
+
+void FilePlayer::set_checkpoint_interval( const unsigned int interval, const string & directory )
+{
+  checkpoint_interval_ = interval;
+  checkpoint_directory_ = directory;
+
+  /* a stream may have no path, in which case its name stands in */
+  string path = filename_;
+  char * const resolved = realpath( filename_.c_str(), nullptr );
+  if ( resolved ) {
+    path = resolved;
+    free( resolved );
+  }
+
+  const string::size_type slash = filename_.rfind( '/' );
+  const string stream_name = slash == string::npos ? filename_ : filename_.substr( slash + 1 );
+
+  char hash[ 17 ];
+  snprintf( hash, sizeof( hash ), "%016llx", static_cast<unsigned long long>( path_hash( path ) ) );
+
+  checkpoint_prefix_ = stream_name + "." + hash;
+}
+
+string FilePlayer::checkpoint_filename( const unsigned int frame_no ) const
+{
+  return checkpoint_directory_ + "/" + checkpoint_prefix_ + "." + to_string( frame_no ) + ".checkpoint";
+}
+
+DecoderCheckpoint::Source FilePlayer::checkpoint_source( void ) const
+{
+  if ( stream_ ) {
+    return { 0, 0 };
+  }
+
+  return { file_->size(), file_->modification_time() };
+}
+
+void FilePlayer::save_checkpoint_if_due( void )
+{
+  if ( checkpoint_interval_ == 0 or frame_no_ % checkpoint_interval_ != 0 or eof() ) {
+    return;
+  }
+
+  /* one left by an earlier version of the file is replaced */
+  const string filename = checkpoint_filename( frame_no_ );
+  const DecoderCheckpoint::Source source = checkpoint_source();
+  if ( not DecoderCheckpoint::saved_from( filename, frame_no_, source ) ) {
+    DecoderCheckpoint::write( filename, decoder_, frame_no_, source );
+  }
+}
+
+void FilePlayer::resume( const string & checkpoint_filename )
+{
+  const DecoderCheckpoint checkpoint = DecoderCheckpoint::read( checkpoint_filename );
+
+  /* a stream cannot be told from another */
+  if ( not stream_ and checkpoint.source() != checkpoint_source() ) {
+    throw Invalid( checkpoint_filename + " is of another version of the file" );
+  }
+
+  if ( stream_ ) {
+    if ( checkpoint.frame_no() < frame_no_ ) {
+      throw Invalid( "checkpoint is behind the stream" );
+    }
+
+    /* skip to the checkpoint's frame, which is the only way to get there */
+    while ( frame_no_ < checkpoint.frame_no() ) {
+      if ( stream_->eof() ) {
+        throw Invalid( "checkpoint is past the end of the file" );
+      }
+      get_next_frame();
+    }
+  } else if ( checkpoint.frame_no() > file_->frame_count() ) {
+    throw Invalid( "checkpoint is past the end of the file" );
+  }
+
+  parser_.reset();
+
+  restore( checkpoint );
+  frame_no_ = checkpoint.frame_no();
+
+  set_parse_ahead( parse_ahead_ );
 }
 
 RasterHandle FilePlayer::advance( void )
 {
   while ( not eof() ) {
-    Optional<RasterHandle> raster = decode( get_next_frame().chunk );
+    Optional<RasterHandle> raster = parser_ ? decode_parsed_frame() : decode( get_next_frame().chunk );
+    save_checkpoint_if_due();
     if ( raster.initialized() ) {
       return raster.get();
     }
@@ -114,12 +276,91 @@ RasterHandle FilePlayer::advance( void )
   throw Unsupported( "hidden frames at end of file" );
 }
 
+const vector<unsigned int> & FilePlayer::key_frame_index( void )
+{
+  if ( key_frames_.empty() ) {
+    /* the frame tag alone says whether a frame is a key frame */
+    for ( unsigned int i = 0; i < file().frame_count(); i++ ) {
+      if ( decoder_.decompress_frame( file().frame( i ) ).key_frame() ) {
+        key_frames_.push_back( i );
+      }
+    }
+  }
+
+  return key_frames_;
+}
+
+RasterHandle FilePlayer::seek( const unsigned int frame_no )
+{
+  const auto start = chrono::steady_clock::now();
+
+  if ( frame_no >= file().frame_count() ) {
+    throw Invalid( "seek past end of file" );
+  }
+
+  const vector<unsigned int> & key_frames = key_frame_index();
+  const auto next_key_frame = upper_bound( key_frames.begin(), key_frames.end(), frame_no );
+  if ( next_key_frame == key_frames.begin() ) {
+    throw Invalid( "no key frame before seek target" );
+  }
+
+  unsigned int start_frame = *prev( next_key_frame );
+
+  /* the decoder is already past that key frame, and short of the target */
+  if ( frame_no_ > start_frame and frame_no_ <= frame_no ) {
+    start_frame = frame_no_;
+  }
+
+  /* the parser's lookahead starts from the wrong place now */
+  parser_.reset();
+
+  if ( checkpoint_interval_ > 0 ) {
+    const DecoderCheckpoint::Source source = checkpoint_source();
+    for ( unsigned int checkpoint_frame = frame_no - frame_no % checkpoint_interval_;
+          checkpoint_frame > start_frame;
+          checkpoint_frame -= checkpoint_interval_ ) {
+      /* ones of an earlier version of the file are passed over */
+      const string filename = checkpoint_filename( checkpoint_frame );
+      if ( DecoderCheckpoint::saved_from( filename, checkpoint_frame, source ) ) {
+        const DecoderCheckpoint checkpoint = DecoderCheckpoint::read( filename );
+        if ( checkpoint.frame_no() != checkpoint_frame or checkpoint.source() != source ) {
+          throw Invalid( filename + " changed while it was read" );
+        }
+
+        restore( checkpoint );
+        start_frame = checkpoint_frame;
+        break;
+      }
+    }
+  }
+
+  SeekStatistics statistics { start_frame, 0, 0, chrono::nanoseconds { 0 } };
+
+  for ( frame_no_ = start_frame; frame_no_ < frame_no; frame_no_++ ) {
+    if ( decoder_.skip_frame( file_->frame( frame_no_ ) ) ) {
+      statistics.frames_reconstructed++;
+    } else {
+      statistics.frames_skipped++;
+    }
+  }
+
+  const RasterHandle output = decoder_.get_frame_output( file_->frame( frame_no_++ ) ).second;
+  statistics.frames_reconstructed++;
+
+  set_parse_ahead( parse_ahead_ );
+
+  statistics.latency = chrono::steady_clock::now() - start;
+  last_seek_ = statistics;
+
+  return output;
+}
+
 bool FilePlayer::eof( void ) const
 {
-  return frame_no_ == file_.frame_count();
+  return stream_ ? stream_->eof() : frame_no_ == file_->frame_count();
 }
 
 long unsigned int FilePlayer::original_size( void ) const
 {
-  return file_.frame( cur_frame_no() ).size();
+  return file().frame( cur_frame_no() ).size();
 }
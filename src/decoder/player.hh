@@ -4,10 +4,13 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <chrono>
 
 #include "ivf.hh"
 #include "frame_info.hh"
 #include "decoder.hh"
+#include "pipelined_parser.hh"
+#include "checkpoint.hh"
 
 struct FrameRawData
 {
@@ -32,6 +35,11 @@ public:
 
   Optional<RasterHandle> safe_decode( const FrameInfo & info, const Chunk & chunk );
 
+  void set_thread_count( const unsigned int thread_count ) { decoder_.set_thread_count( thread_count ); }
+
+  /* take on the decoder a checkpoint saved, keeping this player's threads */
+  void restore( const DecoderCheckpoint & checkpoint );
+
   const VP8Raster & example_raster( void ) const;
 
   bool can_decode( const FrameInfo & frame ) const;
@@ -47,21 +55,98 @@ public:
 
 class FilePlayer : public FramePlayer
 {
+public:
+  struct SeekStatistics
+  {
+    unsigned int start_frame;            /* a key frame, a checkpoint, or where the player was */
+    unsigned int frames_reconstructed;   /* including the target */
+    unsigned int frames_skipped;         /* parsed only; nothing references their output */
+    std::chrono::nanoseconds latency;
+  };
+
 private:
-  IVF file_;
+  /* exactly one of these is set */
+  std::unique_ptr<IVF> file_;
+  std::unique_ptr<IVFStream> stream_;
+
   unsigned int frame_no_ { 0 };
   std::string filename_;
-  FilePlayer( const std::string & filename, IVF && file );
+
+  /* parses the rest of the file ahead of advance(), if enabled */
+  std::unique_ptr<PipelinedParser> parser_ {};
+  unsigned int parse_ahead_ { 0 };
+
+  /* frame numbers of the key frames, found on the first seek */
+  std::vector<unsigned int> key_frames_ {};
+
+  SeekStatistics last_seek_ { 0, 0, 0, std::chrono::nanoseconds { 0 } };
+
+  /* a checkpoint is saved in checkpoint_directory_ before every frame
+     numbered a multiple of this (0 = never) */
+  unsigned int checkpoint_interval_ { 0 };
+  std::string checkpoint_directory_ {};
+
+  /* the stream's name and a hash of its full path, so that same-named
+     streams in different directories never share checkpoints */
+  std::string checkpoint_prefix_ {};
+
+  FilePlayer( const std::string & filename, std::unique_ptr<IVF> && file, std::unique_ptr<IVFStream> && stream );
+
+  /* frames by number, which a stream cannot give */
+  const IVF & file() const;
+
+  /* the frame get_next_frame() would return */
+  Chunk peek_frame();
+
+  Optional<RasterHandle> decode_parsed_frame();
+
+  const std::vector<unsigned int> & key_frame_index();
+
+  /* what the checkpoints of this stream record it as */
+  DecoderCheckpoint::Source checkpoint_source() const;
+
+  void save_checkpoint_if_due();
 
 protected:
+  /* not to be mixed with advance() while parsing ahead */
   FrameRawData get_next_frame();
 
 public:
   FilePlayer( const std::string & filename );
+
+  /* Plays an IVF stream read front to back from input, such as a pipe;
+     checkpoints are named after name. Such a player can neither seek nor
+     parse ahead. */
+  FilePlayer( FileDescriptor && input, const std::string & name = "stdin" );
+
+  /* parse up to this many frames ahead of advance() on another thread (0 = off) */
+  void set_parse_ahead( const unsigned int frames );
+
+  /* Save a checkpoint every interval frames as advance() passes them,
+     and let seek() start from the nearest one in directory, including
+     those saved by earlier runs over the same file. */
+  void set_checkpoint_interval( const unsigned int interval, const std::string & directory );
+
+  /* where the checkpoint taken before frame_no is kept */
+  std::string checkpoint_filename( const unsigned int frame_no ) const;
+
+  /* carry on from a checkpoint of this file, e.g. after a crash */
+  void resume( const std::string & checkpoint_filename );
+
   RasterHandle advance();
   bool eof() const;
   unsigned int cur_frame_no() const { return frame_no_ - 1; }
 
+  /* Decodes frame_no, shown or not, and returns its output; advance()
+     carries on from the frame after it. Decoding starts from the nearest
+     key frame or checkpoint at or before frame_no (or from the current
+     position, if that is nearer), and frames that refresh no reference
+     are parsed but not reconstructed on the way. */
+  RasterHandle seek( const unsigned int frame_no );
+
+  /* how the most recent seek went, and how long it took */
+  const SeekStatistics & last_seek() const { return last_seek_; }
+
   long unsigned int original_size() const;
 };
 
@@ -7,11 +7,11 @@
 using namespace std;
 
 template <unsigned int size>
-VP8Raster::Block<size>::Block( const typename TwoD< Block >::Context & c,
-			    TwoD< uint8_t > & raster_component )
-  : contents_( raster_component, size * c.column, size * c.row ),
-    context_( c ),
-    predictors_( context_ )
+VP8Raster::Block<size>::Block( const TwoD< uint8_t > & raster_component,
+			       const unsigned int column, const unsigned int row )
+  : contents_( raster_component, size * column, size * row ),
+    context_( { column, row } ),
+    predictors_( raster_component, context_ )
 {}
 
 /* the rightmost Y-subblocks in a macroblock (other than the upper-right subblock) are special-cased */
@@ -23,13 +23,13 @@ void VP8Raster::Block4::set_above_right_bottom_row_predictor( const typename Pre
   predictors_.above_right_bottom_row_predictor.use_row = replacement.use_row;
 }
 
-VP8Raster::Macroblock::Macroblock( const TwoD< Macroblock >::Context & c, VP8Raster & raster )
-  : Y( raster.Y_bigblocks_.at( c.column, c.row ) ),
-    U( raster.U_bigblocks_.at( c.column, c.row ) ),
-    V( raster.V_bigblocks_.at( c.column, c.row ) ),
-    Y_sub( raster.Y_subblocks_, 4 * c.column, 4 * c.row ),
-    U_sub( raster.U_subblocks_, 2 * c.column, 2 * c.row ),
-    V_sub( raster.V_subblocks_, 2 * c.column, 2 * c.row )
+VP8Raster::Macroblock::Macroblock( const VP8Raster & raster, const unsigned int column, const unsigned int row )
+  : Y( raster.Y(), column, row ),
+    U( raster.U(), column, row ),
+    V( raster.V(), column, row ),
+    Y_sub( raster.Y(), 4 * column, 4 * row ),
+    U_sub( raster.U(), 2 * column, 2 * row ),
+    V_sub( raster.V(), 2 * column, 2 * row )
 {
   /* adjust "extra pixels" for rightmost Y subblocks in macroblock (other than the top one) */
   for ( unsigned int row = 1; row < 4; row++ ) {
@@ -58,26 +58,34 @@ const typename VP8Raster::Block<size>::Column & VP8Raster::Block<size>::Predicto
   return col;
 }
 
+/* the neighbouring blocks are found from the block's position in the plane */
+static bool has_above_right( const TwoD< uint8_t > & raster_component, const unsigned int size,
+			     const unsigned int column, const unsigned int row )
+{
+  return row > 0 and size * ( column + 1 ) < raster_component.width();
+}
+
 template <unsigned int size>
-VP8Raster::Block<size>::Predictors::Predictors( const typename TwoD< Block >::Context & context )
-  : above_row( context.above.initialized()
-	       ? context.above.get()->contents().row( size - 1 )
+VP8Raster::Block<size>::Predictors::Predictors( const TwoD< uint8_t > & raster_component,
+						const Context & context )
+  : above_row( context.row > 0
+	       ? Row( raster_component, size * context.column, size * context.row - 1 )
 	       : row127() ),
-    left_column( context.left.initialized()
-		 ? context.left.get()->contents().column( size - 1 )
+    left_column( context.column > 0
+		 ? Column( raster_component, size * context.column - 1, size * context.row )
 		 : col129() ),
-    above_left( context.above_left.initialized()
-		? context.above_left.get()->at( size - 1, size - 1 )
-		: ( context.above.initialized()
+    above_left( context.row > 0 and context.column > 0
+		? raster_component.at( size * context.column - 1, size * context.row - 1 )
+		: ( context.row > 0
 		    ? col129().at( 0, 0 )
 		    : row127().at( 0, 0 ) ) ),
-    above_right_bottom_row_predictor( { context.above_right.initialized()
-	  ? context.above_right.get()->contents().row( size - 1 )
+    above_right_bottom_row_predictor( { has_above_right( raster_component, size, context.column, context.row )
+	  ? Row( raster_component, size * ( context.column + 1 ), size * context.row - 1 )
 	  : row127(),
-	  context.above.initialized()
-	  ? &context.above.get()->at( size - 1, size - 1 )
+	  context.row > 0
+	  ? &raster_component.at( size * context.column + size - 1, size * context.row - 1 )
 	  : &row127().at( 0, 0 ),
-	  context.above_right.initialized() } )
+	  has_above_right( raster_component, size, context.column, context.row ) } )
 {}
 
 template <unsigned int size>
@@ -155,7 +163,7 @@ void VP8Raster::Block<size>::dc_predict_simple( TwoDSubRange< uint8_t, size, siz
 template <unsigned int size>
 void VP8Raster::Block<size>::dc_predict( TwoDSubRange< uint8_t, size, size > & output )
 {
-  if ( context_.above.initialized() and context_.left.initialized() ) {
+  if ( context_.row > 0 and context_.column > 0 ) {
     return dc_predict_simple( output );
   }
 
@@ -163,9 +171,9 @@ void VP8Raster::Block<size>::dc_predict( TwoDSubRange< uint8_t, size, size > & o
   static_assert( size == 4 or size == 8 or size == 16, "invalid Block size" );
   static constexpr uint8_t log2size = size == 4 ? 2 : size == 8 ? 3 : size == 16 ? 4 : 0;
 
-  if ( context_.above.initialized() ) {
+  if ( context_.row > 0 ) {
     value = (predictors().above_row.sum(int16_t()) + (1 << (log2size-1))) >> log2size;
-  } else if ( context_.left.initialized() ) {
+  } else if ( context_.column > 0 ) {
     value = (predictors().left_column.sum(int16_t()) + (1 << (log2size-1))) >> log2size;
   }
 
@@ -354,10 +362,14 @@ void VP8Raster::Block<size>::inter_predict( const MotionVector & mv, const TwoD<
   const int source_column = context().column * size + (mv.x() >> 3);
   const int source_row = context().row * size + (mv.y() >> 3);
 
-  if ( source_column - 2 < 0
-       or source_column + size + 3 > reference.width()
-       or source_row - 2 < 0
-       or source_row + size + 3 > reference.height() ) {
+  /* the six-tap filter reads two pixels before and three after the block,
+     which the reference's border covers unless the vector strays past it */
+  const int border = reference.border();
+
+  if ( source_column - 2 < -border
+       or source_column + int( size ) + 3 > int( reference.width() ) + border
+       or source_row - 2 < -border
+       or source_row + int( size ) + 3 > int( reference.height() ) + border ) {
 
     EdgeExtendedRaster safe_reference( reference );
 
@@ -446,7 +458,7 @@ template <unsigned int size>
 void VP8Raster::Block<size>::unsafe_inter_predict( const MotionVector & mv, const TwoD< uint8_t > & reference,
 						   const int source_column, const int source_row )
 {
-  assert( contents_.stride() == reference.width() );
+  assert( contents_.stride() == reference.stride() );
 
   const unsigned int stride = contents_.stride();
 
@@ -454,7 +466,7 @@ void VP8Raster::Block<size>::unsafe_inter_predict( const MotionVector & mv, cons
 
   if ( (mx & 7) == 0 and (my & 7) == 0 ) {
     uint8_t *dest_row_start = &contents_.at( 0, 0 );
-    const uint8_t *src_row_start = &reference.at( source_column, source_row );
+    const uint8_t *src_row_start = &reference.extended_at( source_column, source_row );
     const uint8_t *dest_last_row_start = dest_row_start + size * contents_.stride();
     while ( dest_row_start != dest_last_row_start ) {
       memcpy( dest_row_start, src_row_start, size );
@@ -467,7 +479,7 @@ void VP8Raster::Block<size>::unsafe_inter_predict( const MotionVector & mv, cons
 #ifdef HAVE_SSE2
   alignas(16) SafeArray< SafeArray< uint8_t, size + 8 >, size + 8 > intermediate;
   const uint8_t *intermediate_ptr = &intermediate.at( 0 ).at( 0 );
-  const uint8_t *src_ptr = &reference.at( source_column, source_row );
+  const uint8_t *src_ptr = &reference.extended_at( source_column, source_row );
   const uint8_t *dst_ptr = &contents_.at( 0, 0 );
 
   if ( mx ) {
@@ -494,7 +506,7 @@ void VP8Raster::Block<size>::unsafe_inter_predict( const MotionVector & mv, cons
   {
     uint8_t *intermediate_row_start = &intermediate.at( 0 ).at( 0 );
     const uint8_t *intermediate_last_row_start = intermediate_row_start + size * (size + 5);
-    const uint8_t *src_row_start = &reference.at( source_column - 2, source_row - 2 );
+    const uint8_t *src_row_start = &reference.extended_at( source_column - 2, source_row - 2 );
 
     const auto & horizontal_filter = sixtap_filters.at( mx );
 
@@ -1,58 +1,276 @@
 #include <memory>
-#include <queue>
+#include <mutex>
 #include <functional>
 #include <unordered_map>
 #include <cassert>
+#include <algorithm>
 
-#include "exception.hh"
 #include "raster_handle.hh"
+#include "row_hash.hh"
+#include "decode_timer.hh"
 
 using namespace std;
 
-/* helper to dequeue front element from a queue */
-template <typename T>
-static T dequeue( queue<T> & q )
+/* the bytes of pixel storage held by a raster */
+static uint64_t raster_bytes( const HashCachedRaster & raster )
 {
-  T ret { move( q.front() ) };
-  q.pop();
+  uint64_t ret = 0;
+  for ( const TwoD< uint8_t > * plane : { &raster.Y(), &raster.U(), &raster.V() } ) {
+    ret += uint64_t( plane->stride() ) * ( plane->height() + 2 * plane->border() );
+  }
   return ret;
 }
 
-class RasterPool
+RasterPool::Shard::Shard( RasterPool & s_pool,
+                          const unsigned int s_display_width, const unsigned int s_display_height,
+                          const unsigned int overflow_limit )
+  : overflow_( overflow_limit ),
+    pool( s_pool ), display_width( s_display_width ), display_height( s_display_height )
+{
+  for ( atomic<HashCachedRaster *> & slot : overflow_ ) {
+    slot.store( nullptr, memory_order_relaxed );
+  }
+}
+
+RasterPool::Shard::~Shard()
+{
+  for ( atomic<HashCachedRaster *> & slot : overflow_ ) {
+    delete slot.exchange( nullptr, memory_order_acquire );
+  }
+}
+
+HashCachedRaster * RasterPool::Shard::take( void )
+{
+  for ( atomic<HashCachedRaster *> & slot : overflow_ ) {
+    if ( slot.load( memory_order_relaxed ) ) {
+      HashCachedRaster * raster = slot.exchange( nullptr, memory_order_acquire );
+      if ( raster ) {
+        return raster;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+bool RasterPool::Shard::give( HashCachedRaster * raster )
+{
+  for ( atomic<HashCachedRaster *> & slot : overflow_ ) {
+    HashCachedRaster * expected = nullptr;
+    if ( slot.load( memory_order_relaxed ) == nullptr
+         and slot.compare_exchange_strong( expected, raster, memory_order_release, memory_order_relaxed ) ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void RasterPool::Shard::retire( HashCachedRaster * raster )
+{
+  if ( not give( raster ) ) {
+    pool.bytes_retained_ -= raster_bytes( *raster );
+    delete raster;
+  }
+}
+
+/* the rasters the calling thread has freed and not yet reused, by shard */
+class ThreadRasterCache
 {
 private:
-  queue<RasterHolder> unused_rasters_ {};
+  struct Entry
+  {
+    RasterPool::Shard * shard;
+    vector<HashCachedRaster *> rasters;
+  };
+
+  vector<Entry> entries_ {};
 
 public:
-  RasterHolder make_raster( const unsigned int display_width,
-			    const unsigned int display_height )
+  static thread_local bool destroyed;
+
+  vector<HashCachedRaster *> * find( const RasterPool & pool,
+                                     const unsigned int display_width, const unsigned int display_height,
+                                     RasterPool::Shard ** shard )
   {
-    RasterHolder ret;
-
-    if ( unused_rasters_.empty() ) {
-      ret.reset( new HashCachedRaster( display_width, display_height ) );
-    } else {
-      if ( (unused_rasters_.front()->display_width() != display_width)
-	   or (unused_rasters_.front()->display_height() != display_height) ) {
-	throw Unsupported( "raster size has changed" );
+    for ( Entry & entry : entries_ ) {
+      if ( &entry.shard->pool == &pool
+           and entry.shard->display_width == display_width
+           and entry.shard->display_height == display_height ) {
+        *shard = entry.shard;
+        return &entry.rasters;
       }
+    }
+
+    return nullptr;
+  }
 
-      ret = dequeue( unused_rasters_ );
+  vector<HashCachedRaster *> & add( RasterPool::Shard & shard )
+  {
+    entries_.push_back( { &shard, {} } );
+    return entries_.back().rasters;
+  }
+
+  /* hand back everything kept for a pool that is going away */
+  void forget( const RasterPool & pool )
+  {
+    for ( auto it = entries_.begin(); it != entries_.end(); ) {
+      if ( &it->shard->pool == &pool ) {
+        for ( HashCachedRaster * raster : it->rasters ) {
+          it->shard->retire( raster );
+        }
+        it = entries_.erase( it );
+      } else {
+        it++;
+      }
     }
+  }
 
-    ret.get_deleter().set_raster_pool( this );
-    assert( not ret->has_cache() );
-    return ret;
+  ThreadRasterCache() {}
+
+  ~ThreadRasterCache()
+  {
+    for ( Entry & entry : entries_ ) {
+      for ( HashCachedRaster * raster : entry.rasters ) {
+        entry.shard->retire( raster );
+      }
+    }
+    destroyed = true;
   }
 
-  void free_raster( HashCachedRaster * raster )
+  /* nullptr once the calling thread has started to exit */
+  static ThreadRasterCache * get( void )
   {
-    assert( raster );
-    assert( not raster->has_cache() );
-    unused_rasters_.emplace( raster );
+    if ( destroyed ) {
+      return nullptr;
+    }
+
+    static thread_local ThreadRasterCache cache;
+    return &cache;
   }
+
+  /* forbid copying */
+  ThreadRasterCache( const ThreadRasterCache & other ) = delete;
+  ThreadRasterCache & operator=( const ThreadRasterCache & other ) = delete;
 };
 
+/* trivially destructible, so still readable after the cache is gone */
+thread_local bool ThreadRasterCache::destroyed = false;
+
+RasterPool::RasterPool( const unsigned int thread_cache_limit, const unsigned int overflow_limit )
+  : thread_cache_limit_( thread_cache_limit ), overflow_limit_( overflow_limit )
+{}
+
+RasterPool::~RasterPool()
+{
+  ThreadRasterCache * cache = ThreadRasterCache::get();
+  if ( cache ) {
+    cache->forget( *this );
+  }
+}
+
+RasterPool::Shard & RasterPool::shard( const unsigned int display_width, const unsigned int display_height )
+{
+  unique_lock<mutex> lock { shards_mutex_ };
+  shard_lookups_++;
+
+  for ( Shard & shard : shards_ ) {
+    if ( shard.display_width == display_width and shard.display_height == display_height ) {
+      return shard;
+    }
+  }
+
+  shards_.emplace_back( *this, display_width, display_height, overflow_limit_ );
+  return shards_.back();
+}
+
+RasterHolder RasterPool::make_raster( const unsigned int display_width,
+                                      const unsigned int display_height )
+{
+  RasterHolder ret;
+
+  Shard * shard = nullptr;
+  ThreadRasterCache * cache = ThreadRasterCache::get();
+  vector<HashCachedRaster *> * local = cache ? cache->find( *this, display_width, display_height, &shard ) : nullptr;
+
+  if ( local and not local->empty() ) {
+    ret.reset( local->back() );
+    local->pop_back();
+  } else {
+    /* register the shard, so this thread's later allocations skip the lock */
+    if ( not shard ) {
+      shard = &this->shard( display_width, display_height );
+      if ( cache ) {
+        cache->add( *shard );
+      }
+    }
+    ret.reset( shard->take() );
+  }
+
+  if ( ret ) {
+    hits_++;
+    bytes_retained_ -= raster_bytes( *ret );
+  } else {
+    misses_++;
+    ret.reset( new HashCachedRaster( display_width, display_height ) );
+  }
+
+  ret.get_deleter().set_raster_pool( this );
+  assert( not ret->has_cache() );
+  return ret;
+}
+
+void RasterPool::free_raster( HashCachedRaster * raster )
+{
+  assert( raster );
+  assert( not raster->has_cache() );
+
+  const unsigned int display_width = raster->display_width();
+  const unsigned int display_height = raster->display_height();
+
+  Shard * shard = nullptr;
+  ThreadRasterCache * cache = ThreadRasterCache::get();
+  vector<HashCachedRaster *> * local = cache ? cache->find( *this, display_width, display_height, &shard ) : nullptr;
+
+  if ( not shard ) {
+    shard = &this->shard( display_width, display_height );
+    if ( cache ) {
+      local = &cache->add( *shard );
+    }
+  }
+
+  bytes_retained_ += raster_bytes( *raster );
+
+  if ( local and local->size() < thread_cache_limit_ ) {
+    local->push_back( raster );
+  } else {
+    shard->retire( raster );
+  }
+}
+
+void RasterPool::prewarm( const unsigned int display_width, const unsigned int display_height,
+                          const unsigned int count )
+{
+  Shard & shard = this->shard( display_width, display_height );
+
+  for ( unsigned int i = 0; i < count; i++ ) {
+    HashCachedRaster * raster = new HashCachedRaster( display_width, display_height );
+    bytes_retained_ += raster_bytes( *raster );
+    shard.retire( raster );
+  }
+}
+
+RasterPool::Statistics RasterPool::statistics( void ) const
+{
+  return { hits_, misses_, bytes_retained_, shard_lookups_ };
+}
+
+RasterPool & RasterPool::global( void )
+{
+  static RasterPool pool;
+  return pool;
+}
+
 void RasterDeleter::operator()( HashCachedRaster * raster ) const
 {
   if ( raster_pool_ ) {
@@ -74,14 +292,8 @@ void RasterDeleter::set_raster_pool( RasterPool * pool )
   raster_pool_ = pool;
 }
 
-static RasterPool & global_raster_pool( void )
-{
-  static RasterPool pool;
-  return pool;
-}
-
 MutableRasterHandle::MutableRasterHandle( const unsigned int display_width, const unsigned int display_height )
-  : MutableRasterHandle( display_width, display_height, global_raster_pool() )
+  : MutableRasterHandle( display_width, display_height, RasterPool::global() )
 {}
 
 MutableRasterHandle::MutableRasterHandle( const unsigned int display_width, const unsigned int display_height, RasterPool & raster_pool )
@@ -96,11 +308,22 @@ RasterHandle::RasterHandle( MutableRasterHandle && mutable_raster )
   assert( not raster_->has_cache() );
 }
 
+void MutableRasterHandle::copy_macroblock( const unsigned int column, const unsigned int row,
+                                           const RasterHandle & source )
+{
+  raster_->copy_macroblock( column, row, *source.raster_ );
+}
+
 size_t RasterHandle::hash( void ) const
 {
   return raster_->hash();
 }
 
+size_t RasterHandle::macroblock_hash( const unsigned int column, const unsigned int row ) const
+{
+  return raster_->macroblock_hash( column, row );
+}
+
 bool RasterHandle::operator==( const RasterHandle & other ) const
 {
   return hash() == other.hash();
@@ -113,20 +336,80 @@ bool RasterHandle::operator!=( const RasterHandle & other ) const
 
 size_t HashCachedRaster::hash() const
 {
-  /* XXX need thread safety here in the future */
-  if ( not frozen_hash_.initialized() ) {
-    frozen_hash_.initialize( VP8Raster::raw_hash() );
+  if ( has_hash_.load( memory_order_acquire ) ) {
+    return hash_.load( memory_order_relaxed );
   }
 
-  return frozen_hash_.get();
+  DecodeTimer timer( DecodeStage::Hashing );
+
+  /* only macroblocks not already hashed (or copied with their hash) are read */
+  RowHash hash;
+  vector<size_t> row_hashes( macroblock_width() );
+
+  for ( unsigned int row = 0; row < macroblock_height(); row++ ) {
+    for ( unsigned int column = 0; column < macroblock_width(); column++ ) {
+      row_hashes.at( column ) = macroblock_hash( column, row );
+    }
+    hash.update( reinterpret_cast<const uint8_t *>( row_hashes.data() ),
+                 row_hashes.size() * sizeof( size_t ) );
+  }
+
+  /* racing threads all compute the same value, so any of them may publish it */
+  const size_t hash_val = hash.digest();
+  hash_.store( hash_val, memory_order_relaxed );
+  has_hash_.store( true, memory_order_release );
+
+  return hash_val;
+}
+
+atomic<size_t> & HashCachedRaster::macroblock_hash_slot( const unsigned int column, const unsigned int row ) const
+{
+  assert( column < macroblock_width() and row < macroblock_height() );
+  return macroblock_hashes_.at( row * macroblock_width() + column );
+}
+
+size_t HashCachedRaster::macroblock_hash( const unsigned int column, const unsigned int row ) const
+{
+  atomic<size_t> & slot = macroblock_hash_slot( column, row );
+
+  const size_t cached = slot.load( memory_order_relaxed );
+  if ( cached ) {
+    return cached;
+  }
+
+  RowHash hash;
+
+  for ( const TwoD< uint8_t > * plane : { &Y(), &U(), &V() } ) {
+    const unsigned int size = plane == &Y() ? 16 : 8;
+    for ( unsigned int i = 0; i < size; i++ ) {
+      hash.update( &plane->at( size * column, size * row + i ), size );
+    }
+  }
+
+  /* 0 marks an unhashed macroblock, so it cannot be a hash */
+  const size_t hash_val = max<size_t>( hash.digest(), 1 );
+  slot.store( hash_val, memory_order_relaxed );
+
+  return hash_val;
+}
+
+void HashCachedRaster::copy_macroblock( const unsigned int column, const unsigned int row,
+                                        const HashCachedRaster & source )
+{
+  macroblock( column, row ) = source.macroblock( column, row );
+  macroblock_hash_slot( column, row ).store( source.macroblock_hash_slot( column, row ).load( memory_order_relaxed ),
+                                             memory_order_relaxed );
 }
 
 void HashCachedRaster::reset_cache()
 {
-  frozen_hash_.clear();
+  has_hash_.store( false, memory_order_relaxed );
+  for ( atomic<size_t> & slot : macroblock_hashes_ ) {
+    slot.store( 0, memory_order_relaxed );
+  }
 }
 
 bool HashCachedRaster::has_cache() const
 {
-  return frozen_hash_.initialized();
+  return has_hash_.load( memory_order_acquire );
 }
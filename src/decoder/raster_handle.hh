@@ -1,6 +1,11 @@
 #ifndef RASTER_POOL_HH
 #define RASTER_POOL_HH
 
+#include <atomic>
+#include <vector>
+#include <list>
+#include <mutex>
+
 #include "vp8_raster.hh"
 
 class RasterPool;
@@ -9,12 +14,29 @@ class RasterHandle;
 class HashCachedRaster : public VP8Raster
 {
 private:
-  mutable Optional<size_t> frozen_hash_ {};
+  /* published once hash_ holds the raster's hash, so that several
+     threads can hash the same frozen raster */
+  mutable std::atomic<bool> has_hash_ { false };
+  mutable std::atomic<size_t> hash_ { 0 };
+
+  /* filled in as each macroblock is first hashed, 0 until then */
+  mutable std::vector< std::atomic<size_t> > macroblock_hashes_ =
+    std::vector< std::atomic<size_t> >( macroblock_width() * macroblock_height() );
+
+  std::atomic<size_t> & macroblock_hash_slot( const unsigned int column, const unsigned int row ) const;
 
 public:
   using VP8Raster::VP8Raster;
 
+  /* combined from the macroblock hashes */
   size_t hash() const;
+  size_t macroblock_hash( const unsigned int column, const unsigned int row ) const;
+
+  /* copy a macroblock, and its hash if known, from a frozen raster; the
+     macroblock must not be written again before this raster is frozen */
+  void copy_macroblock( const unsigned int column, const unsigned int row,
+                        const HashCachedRaster & source );
+
   void reset_cache();
 
   bool has_cache() const;
@@ -34,6 +56,90 @@ public:
 
 typedef std::unique_ptr<HashCachedRaster, RasterDeleter> RasterHolder;
 
+/* Recycles rasters of any number of sizes. A freed raster goes to a short
+   free list belonging to the freeing thread, and from there to a
+   lock-free overflow shared by all threads; allocation looks in the same
+   two places before giving up. The pool must outlive every thread that
+   uses it. */
+class RasterPool
+{
+public:
+  struct Statistics
+  {
+    uint64_t hits, misses, bytes_retained;
+
+    /* times a thread had to look a size up under the pool's lock */
+    uint64_t shard_lookups;
+  };
+
+  /* the rasters of one size, shared by every thread */
+  class Shard
+  {
+  private:
+    /* each slot is empty (nullptr) or owns a raster; rasters move in and
+       out with a single atomic operation, so no slot is ever shared */
+    std::vector< std::atomic<HashCachedRaster *> > overflow_;
+
+  public:
+    RasterPool & pool;
+    const unsigned int display_width, display_height;
+
+    Shard( RasterPool & s_pool, const unsigned int s_display_width, const unsigned int s_display_height,
+           const unsigned int overflow_limit );
+    ~Shard();
+
+    /* nullptr if the overflow is empty */
+    HashCachedRaster * take( void );
+
+    /* false (and the caller keeps the raster) if the overflow is full */
+    bool give( HashCachedRaster * raster );
+
+    /* pass a raster the calling thread no longer wants to the other threads */
+    void retire( HashCachedRaster * raster );
+
+    /* forbid copying or moving */
+    Shard( const Shard & other ) = delete;
+    Shard & operator=( const Shard & other ) = delete;
+  };
+
+private:
+  /* one per raster size, never removed */
+  std::mutex shards_mutex_ {};
+  std::list<Shard> shards_ {};
+
+  std::atomic<unsigned int> thread_cache_limit_;
+  std::atomic<unsigned int> overflow_limit_;
+
+  std::atomic<uint64_t> hits_ { 0 }, misses_ { 0 }, bytes_retained_ { 0 }, shard_lookups_ { 0 };
+
+  Shard & shard( const unsigned int display_width, const unsigned int display_height );
+
+public:
+  RasterPool( const unsigned int thread_cache_limit = 4, const unsigned int overflow_limit = 16 );
+  ~RasterPool();
+
+  RasterHolder make_raster( const unsigned int display_width, const unsigned int display_height );
+  void free_raster( HashCachedRaster * raster );
+
+  /* allocate rasters ahead of time so the first frames find them pooled */
+  void prewarm( const unsigned int display_width, const unsigned int display_height,
+                const unsigned int count );
+
+  /* rasters each thread keeps for itself, per size */
+  void set_thread_cache_limit( const unsigned int limit ) { thread_cache_limit_ = limit; }
+
+  /* rasters shared between threads, per size; applies to sizes not yet seen */
+  void set_overflow_limit( const unsigned int limit ) { overflow_limit_ = limit; }
+
+  Statistics statistics( void ) const;
+
+  static RasterPool & global( void );
+
+  /* forbid copying or moving */
+  RasterPool( const RasterPool & other ) = delete;
+  RasterPool & operator=( const RasterPool & other ) = delete;
+};
+
 class MutableRasterHandle
 {
 friend class RasterHandle;
@@ -51,10 +157,14 @@ public:
 
   const VP8Raster & get( void ) const { return *raster_; }
   VP8Raster & get( void ) { return *raster_; }
+
+  void copy_macroblock( const unsigned int column, const unsigned int row, const RasterHandle & source );
 };
 
 class RasterHandle
 {
+friend class MutableRasterHandle;
+
 private:
   std::shared_ptr<const HashCachedRaster> raster_;
 
@@ -66,6 +176,7 @@ public:
   const VP8Raster & get( void ) const { return *raster_; }
 
   size_t hash( void ) const;
+  size_t macroblock_hash( const unsigned int column, const unsigned int row ) const;
 
   bool operator==( const RasterHandle & other ) const;
   bool operator!=( const RasterHandle & other ) const;
@@ -16,26 +16,44 @@ uint16_t TokenDecoder<length>::decode( BoolDecoder & data ) const
   return base_value_ + increment;
 }
 
-/* The unfolded token decoder is not pretty, but it is considerably faster
-   than using a tree decoder */
+/* Only a Y block's type is decided at runtime (by whether its
+   macroblock has a Y2 block); everything else is known at compile time */
 
 template < BlockType initial_block_type, class PredictionMode >
 void Block< initial_block_type,
 	    PredictionMode >::parse_tokens( BoolDecoder & data,
 					    const ProbabilityTables & probability_tables )
+{
+  if ( initial_block_type == Y_after_Y2 and type_ == Y_without_Y2 ) {
+    parse_tokens_as< Y_without_Y2 >( data, probability_tables );
+  } else {
+    parse_tokens_as< initial_block_type >( data, probability_tables );
+  }
+}
+
+/* The unfolded token decoder is not pretty, but it is considerably faster
+   than using a tree decoder */
+
+template < BlockType initial_block_type, class PredictionMode >
+template < BlockType block_type >
+void Block< initial_block_type,
+	    PredictionMode >::parse_tokens_as( BoolDecoder & data,
+					       const ProbabilityTables & probability_tables )
 {
   bool last_was_zero = false;
 
   /* prediction context starts with number-not-zero count */
-  char token_context = ( context().above.initialized() ? context().above.get()->has_nonzero() : 0 )
+  unsigned int token_context = ( context().above.initialized() ? context().above.get()->has_nonzero() : 0 )
     + ( context().left.initialized() ? context().left.get()->has_nonzero() : 0 );
 
-  for ( unsigned int index = (type_ == BlockType::Y_after_Y2) ? 1 : 0;
+  /* this block type's probabilities */
+  const auto & type_probabilities = probability_tables.coeff_probs.at( block_type );
+
+  for ( unsigned int index = (block_type == BlockType::Y_after_Y2) ? 1 : 0;
 	index < 16;
 	index++ ) {
     /* select the tree probabilities based on the prediction context */
-    const ProbabilityArray< MAX_ENTROPY_TOKENS > & prob
-      = probability_tables.coeff_probs.at( type_ ).at( coefficient_to_band.at( index ) ).at( token_context );
+    const auto & prob = type_probabilities.at( coefficient_to_band.at( index ) ).at( token_context );
 
     /* decode the token */
     if ( not last_was_zero ) {
@@ -105,3 +123,7 @@ void Block< initial_block_type,
     coefficients_.at( zigzag.at( index ) ) = value;
   }
 }
+
+template void YBlock::parse_tokens( BoolDecoder &, const ProbabilityTables & );
+template void Y2Block::parse_tokens( BoolDecoder &, const ProbabilityTables & );
+template void UVBlock::parse_tokens( BoolDecoder &, const ProbabilityTables & );
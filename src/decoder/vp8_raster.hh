@@ -1,6 +1,8 @@
 #ifndef VP8_RASTER_H
 #define VP8_RASTER_H
 
+#include <new>
+
 #include "config.h"
 #include "raster.hh"
 
@@ -28,9 +30,15 @@ public:
     typedef TwoDSubRange< uint8_t, size, 1 > Row;
     typedef TwoDSubRange< uint8_t, 1, size > Column;
 
+    /* position in the plane, in units of blocks */
+    struct Context
+    {
+      unsigned int column, row;
+    };
+
   private:
     TwoDSubRange< uint8_t, size, size > contents_;
-    typename TwoD< Block >::Context context_;
+    Context context_;
 
     void dc_predict() { dc_predict( this->contents_ ); }
     void dc_predict_simple() { dc_predict_simple( this->contents_ ); }
@@ -81,7 +89,7 @@ public:
       uint8_t left( const int8_t row ) const;
       uint8_t east( const int8_t num ) const;
 
-      Predictors( const typename TwoD< Block >::Context & context );
+      Predictors( const TwoD< uint8_t > & raster_component, const Context & context );
     } predictors_;
 
   public:
@@ -90,7 +98,7 @@ public:
     uint8_t east( const int column ) const { return predictors_.east( column ); }
 
   public:
-    Block( const typename TwoD< Block >::Context & c, TwoD< uint8_t > & raster_component );
+    Block( const TwoD< uint8_t > & raster_component, const unsigned int column, const unsigned int row );
 
     uint8_t & at( const unsigned int column, const unsigned int row )
     { return contents_.at( column, row ); }
@@ -136,7 +144,7 @@ public:
 
     void set_above_right_bottom_row_predictor( const typename Predictors::AboveRightBottomRowPredictor & replacement );
 
-    const typename TwoD< Block >::Context & context( void ) const { return context_; }
+    const Context & context( void ) const { return context_; }
 
     static constexpr unsigned int dimension { size };
 
@@ -147,15 +155,72 @@ public:
   using Block8  = Block< 8 >;
   using Block16 = Block< 16 >;
 
+  /* a few neighbouring blocks of one plane, built in place because
+     blocks cannot be default-constructed */
+  template <class BlockType, unsigned int grid_width, unsigned int grid_height>
+  class BlockGrid
+  {
+  private:
+    union {
+      BlockType blocks_[ grid_width * grid_height ];
+    };
+
+  public:
+    BlockGrid( const TwoD< uint8_t > & raster_component,
+	       const unsigned int column, const unsigned int row )
+    {
+      for ( unsigned int i = 0; i < grid_height; i++ ) {
+	for ( unsigned int j = 0; j < grid_width; j++ ) {
+	  new ( &blocks_[ i * grid_width + j ] ) BlockType( raster_component, column + j, row + i );
+	}
+      }
+    }
+
+    BlockType & at( const unsigned int column, const unsigned int row )
+    {
+      assert( column < grid_width and row < grid_height );
+      return blocks_[ row * grid_width + column ];
+    }
+
+    const BlockType & at( const unsigned int column, const unsigned int row ) const
+    {
+      assert( column < grid_width and row < grid_height );
+      return blocks_[ row * grid_width + column ];
+    }
+
+    template <class lambda>
+    void forall( const lambda & f )
+    {
+      for ( BlockType & block : blocks_ ) {
+	f( block );
+      }
+    }
+
+    template <class lambda>
+    void forall_ij( const lambda & f )
+    {
+      for ( unsigned int row = 0; row < grid_height; row++ ) {
+	for ( unsigned int column = 0; column < grid_width; column++ ) {
+	  f( at( column, row ), column, row );
+	}
+      }
+    }
+  };
+
+  /* a view of one macroblock's pixels, made on demand from its position */
   struct Macroblock
   {
-    Block16 & Y;
-    Block8 & U;
-    Block8 & V;
-    TwoDSubRange< Block4, 4, 4 > Y_sub;
-    TwoDSubRange< Block4, 2, 2 > U_sub, V_sub;
+    Block16 Y;
+    Block8 U;
+    Block8 V;
+    BlockGrid< Block4, 4, 4 > Y_sub;
+    BlockGrid< Block4, 2, 2 > U_sub, V_sub;
+
+    Macroblock( const VP8Raster & raster, const unsigned int column, const unsigned int row );
 
-    Macroblock( const TwoD< Macroblock >::Context & c, VP8Raster & raster );
+    /* a copy would be a second view that can write the same pixels */
+    Macroblock( Macroblock && other ) = default;
+    Macroblock( const Macroblock & other ) = delete;
 
     bool operator==( const Macroblock & other ) const
     {
@@ -179,33 +244,68 @@ public:
     }
   };
 
-private:
-  TwoD<Block4> Y_subblocks_ { width_ / 4, height_ / 4, Y_ },
-    U_subblocks_ { width_ / 8, height_ / 8, U_ },
-    V_subblocks_ { width_ / 8, height_ / 8, V_ };
+  /* A macroblock of a const raster. It can be read as a const
+     Macroblock, but not copied into one that writes the pixels. */
+  class ConstMacroblock
+  {
+  private:
+    Macroblock macroblock_;
 
-  TwoD<Block16> Y_bigblocks_ { width_ / 16, height_ / 16, Y_ };
-  TwoD<Block8>  U_bigblocks_ { width_ / 16, height_ / 16, U_ };
-  TwoD<Block8>  V_bigblocks_ { width_ / 16, height_ / 16, V_ };
+  public:
+    ConstMacroblock( const VP8Raster & raster, const unsigned int column, const unsigned int row )
+      : macroblock_( raster, column, row )
+    {}
 
-  TwoD<Macroblock> macroblocks_ { width_ / 16, height_ / 16, *this };
+    operator const Macroblock & () const { return macroblock_; }
+
+    bool operator==( const ConstMacroblock & other ) const { return macroblock_ == other.macroblock_; }
+    bool operator!=( const ConstMacroblock & other ) const { return macroblock_ != other.macroblock_; }
+  };
+
+  /* Only the pixels of one macroblock, with none of the predictors
+     Macroblock builds for every block and subblock. This is all the
+     loop filter needs. */
+  struct MacroblockPixels
+  {
+    TwoDSubRange< uint8_t, 16, 16 > Y;
+    TwoDSubRange< uint8_t, 8, 8 > U, V;
+
+    /* position in the picture, in macroblocks */
+    unsigned int column, row;
+  };
 
-public:
   VP8Raster( const unsigned int display_width, const unsigned int display_height );
 
-  Macroblock & macroblock( const unsigned int column, const unsigned int row )
+  MacroblockPixels macroblock_pixels( const unsigned int column, const unsigned int row )
+  {
+    return { { Y_, 16 * column, 16 * row },
+             { U_, 8 * column, 8 * row },
+             { V_, 8 * column, 8 * row },
+             column, row };
+  }
+
+  const MacroblockPixels macroblock_pixels( const unsigned int column, const unsigned int row ) const
+  {
+    return { { Y_, 16 * column, 16 * row },
+             { U_, 8 * column, 8 * row },
+             { V_, 8 * column, 8 * row },
+             column, row };
+  }
+
+  Macroblock macroblock( const unsigned int column, const unsigned int row )
   {
-    return macroblocks_.at( column, row );
+    return Macroblock( *this, column, row );
   }
 
-  const Macroblock & macroblock( const unsigned int column, const unsigned int row ) const
+  ConstMacroblock macroblock( const unsigned int column, const unsigned int row ) const
   {
-    return macroblocks_.at( column, row );
+    return ConstMacroblock( *this, column, row );
   }
 
   static unsigned int macroblock_dimension( const unsigned int num ) { return ( num + 15 ) / 16; }
 
-  const TwoD<Macroblock> & macroblocks() const { return macroblocks_; }
+  unsigned int macroblock_width( void ) const { return width_ / 16; }
+  unsigned int macroblock_height( void ) const { return height_ / 16; }
 };
 
 class EdgeExtendedRaster
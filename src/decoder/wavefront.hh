@@ -0,0 +1,159 @@
+#ifndef WAVEFRONT_HH
+#define WAVEFRONT_HH
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "2d.hh"
+#include "thread_pool.hh"
+
+/* Per-row completion counters for macroblock-row pipelines. A row
+   publishes how many of its columns are finished, and later rows wait
+   on that count before touching macroblocks that depend on it. */
+class RowProgress
+{
+private:
+  std::vector<std::atomic<unsigned int>> columns_done_;
+  std::atomic<bool> aborted_ { false };
+
+public:
+  RowProgress( const unsigned int rows )
+    : columns_done_( rows )
+  {
+    for ( auto & x : columns_done_ ) {
+      x.store( 0, std::memory_order_relaxed );
+    }
+  }
+
+  void publish( const unsigned int row, const unsigned int columns )
+  {
+    columns_done_[ row ].store( columns, std::memory_order_release );
+  }
+
+  /* returns false if another thread gave up on the frame */
+  bool wait( const unsigned int row, const unsigned int columns ) const
+  {
+    while ( columns_done_[ row ].load( std::memory_order_acquire ) < columns ) {
+      if ( aborted_.load( std::memory_order_relaxed ) ) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+
+  void abort( void ) { aborted_.store( true, std::memory_order_relaxed ); }
+};
+
+/* Visits every element like forall_ij, but spreads the rows across the
+   pool. Row r may process column c once row r - 1 has finished column
+   c + 1, which covers dependencies on the left, above-left, above and
+   above-right neighbours, so the result matches the serial raster-order
+   visit. Without a pool this is just forall_ij. */
+template <class T, class lambda>
+void wavefront_forall_ij( const TwoD<T> & grid, ThreadPool * const thread_pool, const lambda & f )
+{
+  if ( thread_pool == nullptr or thread_pool->concurrency() == 1 or grid.height() == 1 ) {
+    grid.forall_ij( f );
+    return;
+  }
+
+  const unsigned int width = grid.width(), height = grid.height();
+  const unsigned int threads = std::min( thread_pool->concurrency(), height );
+
+  RowProgress progress( height );
+
+  thread_pool->run( [&] ( const unsigned int thread_index ) {
+      if ( thread_index >= threads ) {
+        return;
+      }
+
+      try {
+        for ( unsigned int row = thread_index; row < height; row += threads ) {
+          for ( unsigned int column = 0; column < width; column++ ) {
+            if ( row > 0 and not progress.wait( row - 1, std::min( column + 2, width ) ) ) {
+              return;
+            }
+
+            f( grid.at( column, row ), column, row );
+            progress.publish( row, column + 1 );
+          }
+        }
+      } catch ( ... ) {
+        progress.abort();
+        throw;
+      }
+    } );
+}
+
+/* Visits every element with f in the same order as wavefront_forall_ij,
+   and with g one row behind: row r - 1 gets g( column - 1 ) right after
+   row r gets f( column ), while its pixels are still in cache. g( r, c )
+   waits until f has finished ( r + 1, c + 1 ) and g has finished
+   ( r - 1, c + 1 ), so it never changes anything f has yet to read from
+   row r. That is the order a loop filter needs behind reconstruction.
+   Without a pool both run on the calling thread. */
+template <class T, class first_lambda, class second_lambda>
+void lagged_wavefront_forall_ij( const TwoD<T> & grid, ThreadPool * const thread_pool,
+                                 const first_lambda & f, const second_lambda & g )
+{
+  const unsigned int width = grid.width(), height = grid.height();
+
+  /* pass r runs f on row r and g on row r - 1, so one more pass than rows */
+  const unsigned int passes = height + 1;
+  const unsigned int threads = ( thread_pool == nullptr ) ? 1 : std::min( thread_pool->concurrency(), passes );
+
+  RowProgress f_progress( height ), g_progress( height );
+
+  auto run_passes = [&] ( const unsigned int thread_index ) {
+    if ( thread_index >= threads ) {
+      return;
+    }
+
+    try {
+      for ( unsigned int pass = thread_index; pass < passes; pass += threads ) {
+        for ( unsigned int column = 0; column <= width; column++ ) {
+          if ( pass < height and column < width ) {
+            const unsigned int row = pass;
+
+            if ( row > 0 and not f_progress.wait( row - 1, std::min( column + 2, width ) ) ) {
+              return;
+            }
+
+            f( grid.at( column, row ), column, row );
+            f_progress.publish( row, column + 1 );
+          }
+
+          if ( pass > 0 and column > 0 ) {
+            const unsigned int row = pass - 1, lagged_column = column - 1;
+            const unsigned int needed = std::min( lagged_column + 2, width );
+
+            if ( not f_progress.wait( std::min( row + 1, height - 1 ), needed )
+                 or not f_progress.wait( row, needed )
+                 or ( row > 0 and not g_progress.wait( row - 1, needed ) ) ) {
+              return;
+            }
+
+            g( grid.at( lagged_column, row ), lagged_column, row );
+            g_progress.publish( row, lagged_column + 1 );
+          }
+        }
+      }
+    } catch ( ... ) {
+      f_progress.abort();
+      g_progress.abort();
+      throw;
+    }
+  };
+
+  if ( threads == 1 ) {
+    run_passes( 0 );
+  } else {
+    thread_pool->run( run_passes );
+  }
+}
+
+#endif /* WAVEFRONT_HH */
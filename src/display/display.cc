@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "exception.hh"
 #include "display.hh"
 
@@ -133,16 +135,58 @@ void VideoDisplay::resize( const pair<unsigned int, unsigned int> & target_size
 }
 
 void VideoDisplay::draw( const BaseRaster & raster )
+{
+  upload( raster );
+  repaint();
+}
+
+/* copy a plane into a pixel buffer without the raster's border */
+static uint8_t * pack_plane( const TwoD<uint8_t> & plane, uint8_t * destination )
+{
+  for ( unsigned int row = 0; row < plane.height(); row++ ) {
+    memcpy( destination, &plane.at( 0, row ), plane.width() );
+    destination += plane.width();
+  }
+
+  return destination;
+}
+
+void VideoDisplay::upload( const BaseRaster & raster )
 {
   if ( width_ != raster.width() or height_ != raster.height() ) {
     throw Invalid( "inconsistent raster dimensions." );
   }
 
-  Y_.load( raster.Y() );
-  U_.load( raster.U() );
-  V_.load( raster.V() );
+  const size_t luma_size = width_ * height_;
+  const size_t chroma_size = ( width_ / 2 ) * ( height_ / 2 );
+  const size_t frame_size = luma_size + 2 * chroma_size;
 
-  repaint();
+  PixelUnpackBuffer::bind( pixel_buffers_.at( next_pixel_buffer_ ) );
+  next_pixel_buffer_ = ( next_pixel_buffer_ + 1 ) % pixel_buffers_.size();
+
+  /* orphan the old storage, so mapping it need not wait for earlier uploads */
+  glBufferData( PixelUnpackBuffer::id, frame_size, nullptr, GL_STREAM_DRAW );
+
+  uint8_t * staging = static_cast<uint8_t *>(
+    glMapBufferRange( PixelUnpackBuffer::id, 0, frame_size,
+                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT ) );
+
+  if ( staging == nullptr ) {
+    PixelUnpackBuffer::unbind();
+    throw Unsupported( "could not map pixel buffer" );
+  }
+
+  staging = pack_plane( raster.Y(), staging );
+  staging = pack_plane( raster.U(), staging );
+  pack_plane( raster.V(), staging );
+
+  glUnmapBuffer( PixelUnpackBuffer::id );
+
+  Y_.load_from_pixel_buffer( 0 );
+  U_.load_from_pixel_buffer( luma_size );
+  V_.load_from_pixel_buffer( luma_size + chroma_size );
+
+  PixelUnpackBuffer::unbind();
 }
 
 void VideoDisplay::repaint( void )
@@ -4,6 +4,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <array>
+
 #include "raster.hh"
 #include "gl_objects.hh"
 
@@ -32,6 +34,11 @@ private:
 
   Texture Y_, U_, V_;
 
+  /* upload() alternates between these, so that filling one never waits
+     on the GPU still reading the other */
+  std::array<PixelBufferObject, 2> pixel_buffers_ {};
+  unsigned int next_pixel_buffer_ { 0 };
+
   VertexArrayObject texture_shader_array_object_ = {};
   VertexBufferObject screen_corners_ = {};
   VertexBufferObject other_vertices_ = {};
@@ -41,7 +48,14 @@ public:
   VideoDisplay( const VideoDisplay & other ) = delete;
   VideoDisplay & operator=( const VideoDisplay & other ) = delete;
 
+  /* upload() and repaint() */
   void draw( const BaseRaster & raster );
+
+  /* stage the raster in a pixel buffer and start loading it into the
+     textures, without putting it on the screen */
+  void upload( const BaseRaster & raster );
+
+  /* draw the last uploaded raster and swap buffers */
   void repaint( void );
   void resize( const std::pair<unsigned int, unsigned int> & target_size );
 
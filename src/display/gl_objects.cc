@@ -115,6 +115,17 @@ VertexBufferObject::~VertexBufferObject()
   glDeleteBuffers( 1, &num_ );
 }
 
+PixelBufferObject::PixelBufferObject()
+  : num_()
+{
+  glGenBuffers( 1, &num_ );
+}
+
+PixelBufferObject::~PixelBufferObject()
+{
+  glDeleteBuffers( 1, &num_ );
+}
+
 VertexArrayObject::VertexArrayObject()
   : num_()
 {
@@ -171,11 +182,19 @@ void Texture::load( const TwoD< uint8_t > & raster )
   }*/
 
   glBindTexture( GL_TEXTURE_RECTANGLE, num_ );
-  glPixelStorei( GL_UNPACK_ROW_LENGTH, width_ );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, raster.stride() );
   glTexSubImage2D( GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, width_, height_,
                    GL_LUMINANCE, GL_UNSIGNED_BYTE, &( raster.at( 0, 0 ) ) );
 }
 
+void Texture::load_from_pixel_buffer( const size_t offset )
+{
+  glBindTexture( GL_TEXTURE_RECTANGLE, num_ );
+  glPixelStorei( GL_UNPACK_ROW_LENGTH, width_ );
+  glTexSubImage2D( GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, width_, height_,
+                   GL_LUMINANCE, GL_UNSIGNED_BYTE, reinterpret_cast<const void *>( offset ) );
+}
+
 void compile_shader( const GLuint num, const string & source )
 {
   const char * source_c_str = source.c_str();
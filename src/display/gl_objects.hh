@@ -64,10 +64,16 @@ public:
     glBufferData( id, vertices.size() * sizeof( VertexObject ), &vertices.front(), usage );
   }
 
+  static void unbind( void )
+  {
+    glBindBuffer( id_, 0 );
+  }
+
   constexpr static GLenum id = id_;
 };
 
 using ArrayBuffer = Buffer<GL_ARRAY_BUFFER>;
+using PixelUnpackBuffer = Buffer<GL_PIXEL_UNPACK_BUFFER>;
 
 class VertexBufferObject
 {
@@ -84,6 +90,25 @@ public:
   VertexBufferObject & operator=( const VertexBufferObject & other ) = delete;
 };
 
+/* Staging memory for texture uploads. While one is bound as the
+   PixelUnpackBuffer, Texture::load_from_pixel_buffer() reads from it
+   instead of from client memory, so the copy into the texture can run
+   on the GPU's schedule rather than stalling the caller. */
+class PixelBufferObject
+{
+  friend PixelUnpackBuffer;
+
+  GLuint num_;
+
+public:
+  PixelBufferObject();
+  ~PixelBufferObject();
+
+  /* forbid copy */
+  PixelBufferObject( const PixelBufferObject & other ) = delete;
+  PixelBufferObject & operator=( const PixelBufferObject & other ) = delete;
+};
+
 class VertexArrayObject
 {
   GLuint num_;
@@ -111,6 +136,10 @@ public:
 
   void bind( const GLenum texture_unit );
   void load( const TwoD< uint8_t> & raster );
+
+  /* load from the bound PixelUnpackBuffer, where the plane starts at offset
+     with rows packed width() bytes apart */
+  void load_from_pixel_buffer( const size_t offset );
   void resize( const unsigned int width, const unsigned int height );
   std::pair<unsigned int, unsigned int> size( void ) const { return std::make_pair( width_, height_ ); }
 
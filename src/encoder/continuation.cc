@@ -339,20 +339,22 @@ void InterFrameMacroblock::record_dependencies( vector<vector<bool>> & required
   }
 }
 
-static RasterHandle make_new_reference( const reference_frame & frame, const VP8Raster & current,
-                                        const VP8Raster & target, const ReferenceDependency & deps )
+/* every macroblock is copied unchanged, so the new reference keeps the
+   macroblock hashes already known and hashing it is nearly free */
+static RasterHandle make_new_reference( const reference_frame & frame, const RasterHandle & current,
+                                        const RasterHandle & target, const ReferenceDependency & deps )
 {
-  assert( VP8Raster::macroblock_dimension( current.display_height() ) == deps.num_macroblocks_vert() );
-  assert( VP8Raster::macroblock_dimension( current.display_width() ) == deps.num_macroblocks_horiz() );
+  assert( VP8Raster::macroblock_dimension( current.get().display_height() ) == deps.num_macroblocks_vert() );
+  assert( VP8Raster::macroblock_dimension( current.get().display_width() ) == deps.num_macroblocks_horiz() );
 
-  MutableRasterHandle mutable_raster( current.display_width(), current.display_height() );
+  MutableRasterHandle mutable_raster( current.get().display_width(), current.get().display_height() );
 
   for ( unsigned row = 0; row < deps.num_macroblocks_vert(); row++ ) {
     for ( unsigned col = 0; col < deps.num_macroblocks_horiz(); col++ ) {
       if ( deps.need_update_macroblock( frame, col, row ) ) {
-        mutable_raster.get().macroblock( col, row ) = target.macroblock( col, row );
+        mutable_raster.copy_macroblock( col, row, target );
       } else {
-        mutable_raster.get().macroblock( col, row ) = current.macroblock( col, row );
+        mutable_raster.copy_macroblock( col, row, current );
       }
     }
   }
@@ -360,14 +362,32 @@ static RasterHandle make_new_reference( const reference_frame & frame, const VP8
   return RasterHandle( move( mutable_raster ) );
 }
 
+/* Different hashes rule out a match cheaply; equal ones are confirmed
+   against the pixels, as a collision would otherwise go unnoticed */
+static bool equal_macroblocks( const RasterHandle & raster, const RasterHandle & other,
+                               const unsigned int column, const unsigned int row )
+{
+  if ( raster.macroblock_hash( column, row ) != other.macroblock_hash( column, row ) ) {
+    return false;
+  }
+
+  if ( &raster.get() == &other.get() ) {
+    return true;
+  }
+
+  const VP8Raster::MacroblockPixels pixels = raster.get().macroblock_pixels( column, row );
+  const VP8Raster::MacroblockPixels other_pixels = other.get().macroblock_pixels( column, row );
+
+  return pixels.Y == other_pixels.Y and pixels.U == other_pixels.U and pixels.V == other_pixels.V;
+}
+
 static bool partially_equal_reference( const reference_frame & frame, const RasterHandle & reference,
                                        const RasterHandle & other_reference, const ReferenceDependency & deps )
 {
-  for ( unsigned row = 0; row < reference.get().macroblocks().height(); row++ ) {
-    for ( unsigned col = 0; col < reference.get().macroblocks().width(); col++ ) {
-      const VP8Raster::Macroblock & macroblock = reference.get().macroblock( col, row );
-      const VP8Raster::Macroblock & other = other_reference.get().macroblock( col, row );
-      if ( deps.need_update_macroblock( frame, col, row ) and macroblock != other ) {
+  for ( unsigned row = 0; row < reference.get().macroblock_height(); row++ ) {
+    for ( unsigned col = 0; col < reference.get().macroblock_width(); col++ ) {
+      if ( deps.need_update_macroblock( frame, col, row )
+           and not equal_macroblocks( reference, other_reference, col, row ) ) {
         return false;
       }
     }
@@ -495,24 +515,31 @@ void InterFrame::analyze_dependencies( const ReferenceDependency & deps ) const
 
   macroblock_headers_.get().forall_ij( [&] ( const InterFrameMacroblock & macroblock, const unsigned col, const unsigned row ) {
                                         if ( macroblock.inter_coded() ) {
-                                          macroblock.analyze_dependencies( raster.macroblock( col, row ), fake_refs.at( macroblock.header().reference() ) );
+                                          VP8Raster::Macroblock raster_macroblock = raster.macroblock( col, row );
+                                          macroblock.analyze_dependencies( raster_macroblock, fake_refs.at( macroblock.header().reference() ) );
                                         }
                                        } );
 }
 
-ReferenceUpdater::ReferenceUpdater( const reference_frame & frame, const VP8Raster & current,
-                                    const VP8Raster & target, const ReferenceDependency & deps )
+ReferenceUpdater::ReferenceUpdater( const reference_frame & frame, const RasterHandle & current,
+                                    const RasterHandle & target, const ReferenceDependency & deps )
   : new_reference_( make_new_reference( frame, current, target, deps ) ),
     diffs_( deps.num_macroblocks_vert(), vector<Optional<ReferenceUpdater::MacroblockDiff>>( deps.num_macroblocks_horiz() ) ),
-    prob_skip_( 0 ), width_( target.width() ), height_( target.height() )
+    prob_skip_( 0 ), width_( target.get().width() ), height_( target.get().height() )
 {
-  assert( current.width() == target.width() and current.height() == target.height() );
+  assert( current.get().width() == target.get().width() and current.get().height() == target.get().height() );
   // FIXME revisit this function
   unsigned num_updated = 0;
   for ( unsigned row = 0; row < diffs_.size(); row++ ) {
     for ( unsigned col = 0; col < diffs_[ 0 ].size(); col++ ) {
       if ( deps.need_update_macroblock( frame, col, row ) ) {
-        diffs_[ row ][ col ].initialize( ReferenceUpdater::MacroblockDiff( target.macroblock( col, row ), current.macroblock( col, row ) ) );
+        /* an unchanged macroblock needs no subtraction to know its residue is zero */
+        if ( equal_macroblocks( target, current, col, row ) ) {
+          diffs_[ row ][ col ].initialize( ReferenceUpdater::MacroblockDiff() );
+        } else {
+          diffs_[ row ][ col ].initialize( ReferenceUpdater::MacroblockDiff( target.get().macroblock( col, row ),
+                                                                             current.get().macroblock( col, row ) ) );
+        }
         num_updated++;
       }
     }
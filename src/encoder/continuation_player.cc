@@ -54,7 +54,7 @@ SerializedFrame ContinuationPlayer::make_state_update( const SourcePlayer & sour
 
   DecoderState new_state = source.decoder_.get_state();
   vector<uint8_t> raw = state_frame.serialize( new_state.probability_tables );
-  new_state.probability_tables.update( state_frame.header() );
+  new_state.probability_tables.mutate().update( state_frame.header() );
 
   assert( new_state.probability_tables == decoder_.get_state().probability_tables );
 
@@ -4,6 +4,8 @@
 
 #include "encoder.hh"
 #include "frame_header.hh"
+#include "thread_pool.hh"
+#include "ssim.hh"
 
 using namespace std;
 
@@ -68,14 +70,33 @@ void VP8Raster::Block<size>::intra_predict( const PredictionMode mb_mode, TwoD<u
 
 /* Encoder */
 Encoder::Encoder( const string & output_filename, const uint16_t width,
-                  const uint16_t height, const bool two_pass )
-  : ivf_writer_( output_filename, "VP80", width, height, 1, 1 ),
+                  const uint16_t height, const bool two_pass,
+                  const IVFWriter::Durability durability )
+  : ivf_writer_( output_filename, "VP80", width, height, 1, 1, IVFWriter::Mode::Batched, durability ),
     width_( width ), height_( height ), temp_raster_handle_( width, height ),
     decoder_state_( width, height ), costs_(), two_pass_encoder_( two_pass )
 {
   costs_.fill_mode_costs();
 }
 
+void Encoder::set_thread_count( const unsigned int thread_count )
+{
+  if ( thread_count > 1 ) {
+    thread_pool_ = make_shared<ThreadPool>( thread_count );
+  } else {
+    thread_pool_.reset();
+  }
+}
+
+double Encoder::quality( const VP8Raster & reconstructed, const VP8Raster & original ) const
+{
+  if ( ssim_all_planes_ ) {
+    return raster_quality( reconstructed, original, thread_pool_.get() ).ssim();
+  }
+
+  return reconstructed.quality( original, thread_pool_.get() );
+}
+
 template<unsigned int size>
 uint32_t Encoder::sse( const VP8Raster::Block<size> & block,
                        const TwoDSubRange<uint8_t, size, size> & prediction )
@@ -558,6 +579,12 @@ void Encoder::trellis_quantize( FrameSubblockType & frame_sb,
   }
 }
 
+/* the kernels are also timed on their own, by the kernel benchmarks */
+template uint32_t Encoder::sse( const VP8Raster::Block4 &, const TwoDSubRange<uint8_t, 4, 4> & );
+template uint32_t Encoder::sse( const VP8Raster::Block8 &, const TwoDSubRange<uint8_t, 8, 8> & );
+template uint32_t Encoder::variance( const VP8Raster::Block16 &, const TwoDSubRange<uint8_t, 16, 16> & );
+template void Encoder::trellis_quantize( YBlock &, const Quantizer & ) const;
+
 uint32_t Encoder::rdcost( uint32_t rate, uint32_t distortion,
                           uint32_t rate_multiplier,
                           uint32_t distortion_multiplier )
@@ -588,7 +615,7 @@ void Encoder::optimize_probability_tables( FrameType & frame, const TokenBranchC
     }
   }
 
-  decoder_state_.probability_tables.coeff_prob_update( frame.header() );
+  decoder_state_.probability_tables.mutate().coeff_prob_update( frame.header() );
 }
 
 template<>
@@ -630,12 +657,12 @@ pair<KeyFrame, double> Encoder::encode_with_quantizer<KeyFrame>( const VP8Raster
       token_branch_counts = TokenBranchCounts();
     }
 
-    raster.macroblocks().forall_ij(
-      [&] ( VP8Raster::Macroblock & original_mb, unsigned int mb_column, unsigned int mb_row )
+    frame.mutable_macroblocks().forall_ij(
+      [&] ( KeyFrameMacroblock & frame_mb, unsigned int mb_column, unsigned int mb_row )
       {
-        auto & reconstructed_mb = reconstructed_raster.macroblock( mb_column, mb_row );
-        auto & temp_mb = temp_raster().macroblock( mb_column, mb_row );
-        auto & frame_mb = frame.mutable_macroblocks().at( mb_column, mb_row );
+        const auto original_mb = raster.macroblock( mb_column, mb_row );
+        auto reconstructed_mb = reconstructed_raster.macroblock( mb_column, mb_row );
+        auto temp_mb = temp_raster().macroblock( mb_column, mb_row );
 
         // Process Y and Y2
         luma_mb_intra_predict( original_mb, reconstructed_mb, temp_mb, frame_mb, quantizer, FIRST_PASS );
@@ -676,9 +703,10 @@ pair<KeyFrame, double> Encoder::encode_with_quantizer<KeyFrame>( const VP8Raster
     decoder_state_.filter_adjustments.clear();
     decoder_state_.filter_adjustments.initialize( frame.header() );
 
-    frame.loopfilter( decoder_state_.segmentation, decoder_state_.filter_adjustments, temp_raster() );
+    frame.loopfilter( decoder_state_.segmentation, decoder_state_.filter_adjustments, temp_raster(),
+                      thread_pool_.get() );
 
-    double ssim = temp_raster().quality( raster );
+    double ssim = quality( temp_raster(), raster );
 
     if ( ssim > best_ssim ) {
       best_ssim = ssim;
@@ -693,8 +721,9 @@ pair<KeyFrame, double> Encoder::encode_with_quantizer<KeyFrame>( const VP8Raster
   decoder_state_.filter_adjustments.clear();
   decoder_state_.filter_adjustments.initialize( frame.header() );
 
-  frame.loopfilter( decoder_state_.segmentation, decoder_state_.filter_adjustments, reconstructed_raster );
-  return make_pair( move( frame ), reconstructed_raster.quality( raster ) );
+  frame.loopfilter( decoder_state_.segmentation, decoder_state_.filter_adjustments, reconstructed_raster,
+                    thread_pool_.get() );
+  return make_pair( move( frame ), quality( reconstructed_raster, raster ) );
 }
 
 double Encoder::encode_as_keyframe( const VP8Raster & raster,
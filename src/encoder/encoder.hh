@@ -5,12 +5,15 @@
 #include <string>
 #include <tuple>
 #include <limits>
+#include <memory>
 
 #include "frame.hh"
 #include "vp8_raster.hh"
 #include "ivf_writer.hh"
 #include "costs.hh"
 
+class ThreadPool;
+
 enum EncoderPass
 {
   FIRST_PASS,
@@ -19,6 +22,9 @@ enum EncoderPass
 
 class Encoder
 {
+/* src/bench/kernel-bench times the per-block kernels below directly */
+friend class KernelBench;
+
 private:
   IVFWriter ivf_writer_;
   uint16_t width_;
@@ -27,9 +33,15 @@ private:
   DecoderState decoder_state_;
   Costs costs_;
 
+  /* null means filter on the calling thread only */
+  std::shared_ptr<ThreadPool> thread_pool_ {};
+
   double minimum_ssim_ { 0.8 };
   bool two_pass_encoder_ { false };
 
+  /* whether minimum_ssim applies to the combined SSIM of all three planes, not just luma */
+  bool ssim_all_planes_ { false };
+
   // TODO: Where did these come from? Are these the possible values?
   uint32_t RATE_MULTIPLIER { 300 };
   uint32_t DISTORTION_MULTIPLIER { 1 };
@@ -81,14 +93,28 @@ private:
 
   VP8Raster & temp_raster() { return temp_raster_handle_.get(); }
 
+  /* the SSIM that minimum_ssim is compared against */
+  double quality( const VP8Raster & reconstructed, const VP8Raster & original ) const;
+
 public:
+  /* frames are written by a background thread, so encoding does not wait on storage */
   Encoder( const std::string & output_filename, const uint16_t width,
-           const uint16_t height, const bool two_pass );
+           const uint16_t height, const bool two_pass,
+           const IVFWriter::Durability durability = IVFWriter::Durability::None );
 
   double encode_as_keyframe( const VP8Raster & raster,
                              const double minimum_ssim,
                              const uint8_t y_ac_qi = std::numeric_limits<uint8_t>::max() );
 
+  /* wait for every frame to be written out; throws if writing failed */
+  void finish( void ) { ivf_writer_.close(); }
+
+  /* loop-filter macroblock rows in parallel on this many threads (1 = serial) */
+  void set_thread_count( const unsigned int thread_count );
+
+  /* aim for the combined SSIM of all three planes rather than luma SSIM */
+  void set_ssim_all_planes( const bool all_planes ) { ssim_all_planes_ = all_planes; }
+
   static KeyFrame make_empty_frame( const uint16_t width, const uint16_t height );
 };
 
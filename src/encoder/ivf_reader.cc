@@ -4,6 +4,10 @@ IVFReader::IVFReader( const std::string & filename )
   : player_( filename )
 {}
 
+IVFReader::IVFReader( FileDescriptor && input )
+  : player_( std::move( input ) )
+{}
+
 Optional<RasterHandle> IVFReader::get_next_frame()
 {
   if ( player_.eof() ) {
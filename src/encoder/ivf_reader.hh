@@ -11,6 +11,7 @@ private:
 
 public:
   IVFReader( const std::string & filename );
+  IVFReader( FileDescriptor && input );
   Optional<RasterHandle> get_next_frame();
   uint16_t display_width() override { return player_.width(); }
   uint16_t display_height() override { return player_.height(); }
@@ -1,6 +1,9 @@
 #include "yuv4mpeg.hh"
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <cstring>
 #include <sstream>
 #include <utility>
 
@@ -18,7 +21,7 @@ size_t YUV4MPEGHeader::frame_length()
     case C420:
     case C420jpeg:
     case C420paldv:
-      return ( width * height * 3 ) / 2;
+      return y_plane_length() + 2 * uv_plane_length();
     default: throw LogicError();
   }
 }
@@ -40,7 +43,7 @@ size_t YUV4MPEGHeader::uv_plane_length()
     case C420:
     case C420jpeg:
     case C420paldv:
-      return ( width * height / 4 );
+      return ( ( width + 1 ) / 2 ) * ( ( height + 1 ) / 2 );
     default: throw LogicError();
   }
 }
@@ -62,6 +65,13 @@ pair< size_t, size_t > YUV4MPEGReader::parse_fraction( const string & fraction_s
   return make_pair( numerator, denominator );
 }
 
+static pair<FileDescriptor, FileDescriptor> make_pipe( void )
+{
+  int fds[ 2 ];
+  SystemCall( "pipe", pipe( fds ) );
+  return make_pair( FileDescriptor( fds[ 0 ] ), FileDescriptor( fds[ 1 ] ) );
+}
+
 YUV4MPEGReader::YUV4MPEGReader( const string & filename )
   : YUV4MPEGReader( SystemCall( filename,
                     open( filename.c_str(),
@@ -71,9 +81,25 @@ YUV4MPEGReader::YUV4MPEGReader( const string & filename )
 
 YUV4MPEGReader::YUV4MPEGReader( FileDescriptor && fd )
   : header_(),
-    fd_( move( fd ) )
+    fd_( move( fd ) ),
+    wakeup_( make_pipe() )
 {
-  string header_str = fd_.getline();
+  struct stat file_info;
+  SystemCall( "fstat", fstat( fd_.num(), &file_info ) );
+
+  if ( S_ISREG( file_info.st_mode ) and file_info.st_size > 0 ) {
+    mapped_size_ = file_info.st_size;
+    mapping_.reset( new MMap_Region( mapped_size_, PROT_READ, MAP_SHARED, fd_.num() ) );
+    mapped_ = mapping_->addr();
+
+    /* only a hint */
+    madvise( mapping_->addr(), mapped_size_, MADV_SEQUENTIAL );
+  } else {
+    window_.resize( window_size );
+  }
+
+  string header_str;
+  read_line( header_str );
   istringstream ssin( header_str );
 
   string token;
@@ -145,52 +171,184 @@ YUV4MPEGReader::YUV4MPEGReader( FileDescriptor && fd )
   if ( header_.width == 0 or header_.height == 0 ) {
     throw runtime_error( "width or height missing" );
   }
+
+  reader_ = thread( [this] () { read_frames(); } );
 }
 
-Optional<RasterHandle> YUV4MPEGReader::get_next_frame()
+YUV4MPEGReader::~YUV4MPEGReader()
 {
-  MutableRasterHandle raster { header_.width, header_.height };
+  frames_.shut_down();
 
-  string frame_header = fd_.getline();
+  /* the input may be a pipe that never delivers another byte */
+  wakeup_.second.write( string( 1, 0 ) );
 
-  if ( fd_.eof() ) {
-    return Optional<RasterHandle>();
+  reader_.join();
+}
+
+void YUV4MPEGReader::wait_for_input( void )
+{
+  pollfd fds[ 2 ] = { { fd_.num(), POLLIN, 0 }, { wakeup_.first.num(), POLLIN, 0 } };
+  SystemCall( "poll", poll( fds, 2, -1 ) );
+
+  if ( fds[ 1 ].revents ) {
+    throw runtime_error( "yuv4mpeg2 reader shut down" );
   }
+}
 
-  if ( frame_header != "FRAME" ) {
-    throw runtime_error( "invalid yuv4mpeg2 input format" );
+bool YUV4MPEGReader::fill_window( void )
+{
+  /* keep what has not been used yet */
+  memmove( window_.data(), window_.data() + window_begin_, window_end_ - window_begin_ );
+  window_end_ -= window_begin_;
+  window_begin_ = 0;
+
+  wait_for_input();
+  const size_t bytes_read = SystemCall( "read", ::read( fd_.num(), window_.data() + window_end_,
+                                                        window_.size() - window_end_ ) );
+  window_end_ += bytes_read;
+
+  return bytes_read > 0;
+}
+
+bool YUV4MPEGReader::read_line( string & line )
+{
+  if ( mapping_ ) {
+    if ( position_ == mapped_size_ ) {
+      return false;
+    }
+
+    const uint8_t * start = mapped_ + position_;
+    const uint8_t * newline = static_cast<const uint8_t *>( memchr( start, '\n', mapped_size_ - position_ ) );
+    const uint8_t * end = newline ? newline : mapped_ + mapped_size_;
+
+    line.assign( reinterpret_cast<const char *>( start ), end - start );
+    position_ = ( newline ? newline + 1 : end ) - mapped_;
+    return true;
   }
 
-  const size_t CHUNK_SIZE = 500 * 1024;
-  string read_data;
+  size_t searched = 0;
+
+  while ( true ) {
+    const uint8_t * start = window_.data() + window_begin_;
+    const size_t available = window_end_ - window_begin_;
+    const uint8_t * newline = static_cast<const uint8_t *>( memchr( start + searched, '\n', available - searched ) );
 
-  for ( size_t byte = 0; byte < y_plane_length(); byte += read_data.length() ) {
-    read_data = fd_.read( min( CHUNK_SIZE, y_plane_length() - byte ) );
+    if ( newline ) {
+      line.assign( reinterpret_cast<const char *>( start ), newline - start );
+      window_begin_ += newline - start + 1;
+      return true;
+    }
+
+    searched = available;
+
+    if ( available == window_.size() ) {
+      throw runtime_error( "yuv4mpeg2 header line too long" );
+    }
 
-    for ( size_t i = 0; i < read_data.length(); i++ ) {
-      raster.get().Y().at( ( i + byte ) % header_.width,
-                           ( i + byte ) / header_.width ) = read_data[ i ];
+    if ( not fill_window() ) {
+      if ( available == 0 ) {
+        return false;
+      }
+
+      /* the last line need not end in a newline */
+      line.assign( reinterpret_cast<const char *>( start ), available );
+      window_begin_ = window_end_;
+      return true;
     }
   }
+}
 
-  for ( size_t byte = 0; byte < uv_plane_length(); byte += read_data.length() ) {
-    read_data = fd_.read( min( CHUNK_SIZE, uv_plane_length() - byte ) );
+void YUV4MPEGReader::read_plane( TwoD<uint8_t> & plane, const unsigned int width, const unsigned int height )
+{
+  if ( mapping_ ) {
+    if ( mapped_size_ - position_ < uint64_t( width ) * height ) {
+      throw runtime_error( "yuv4mpeg2 input truncated" );
+    }
 
-    for ( size_t i = 0; i < read_data.length(); i++ ) {
-      raster.get().U().at( ( i + byte ) % ( header_.width / 2 ),
-                           ( i + byte ) / ( header_.width / 2 ) ) = read_data[ i ];
+    for ( unsigned int row = 0; row < height; row++ ) {
+      memcpy( &plane.at( 0, row ), mapped_ + position_, width );
+      position_ += width;
     }
+
+    return;
   }
 
-  for ( size_t byte = 0; byte < uv_plane_length(); byte += read_data.length() ) {
-    read_data = fd_.read( min( CHUNK_SIZE, uv_plane_length() - byte ) );
+  /* first whatever the window already holds... */
+  unsigned int row = 0;
+  unsigned int column = 0;
 
-    for ( size_t i = 0; i < read_data.length(); i++ ) {
-      raster.get().V().at( ( i + byte ) % ( header_.width / 2 ),
-                           ( i + byte ) / ( header_.width / 2 ) ) = read_data[ i ];
+  while ( row < height and window_begin_ < window_end_ ) {
+    const size_t length = min( size_t( width - column ), window_end_ - window_begin_ );
+    memcpy( &plane.at( column, row ), window_.data() + window_begin_, length );
+    window_begin_ += length;
+    column += length;
+
+    if ( column == width ) {
+      column = 0;
+      row++;
     }
   }
 
+  /* ...then the rest straight into the rows */
+  iovecs_.clear();
+  for ( ; row < height; row++, column = 0 ) {
+    iovecs_.push_back( { &plane.at( column, row ), size_t( width - column ) } );
+  }
+
+  if ( not fd_.readv( iovecs_, [&] () { wait_for_input(); } ) ) {
+    throw runtime_error( "yuv4mpeg2 input truncated" );
+  }
+}
+
+Optional<RasterHandle> YUV4MPEGReader::read_frame( void )
+{
+  string frame_header;
+
+  if ( not read_line( frame_header ) ) {
+    return Optional<RasterHandle>();
+  }
+
+  /* frame parameters, if any, are ignored */
+  if ( frame_header.compare( 0, 5, "FRAME" ) != 0
+       or ( frame_header.size() > 5 and frame_header.at( 5 ) != ' ' ) ) {
+    throw runtime_error( "invalid yuv4mpeg2 input format" );
+  }
+
+  MutableRasterHandle raster { header_.width, header_.height };
+
+  const unsigned int chroma_width = ( header_.width + 1 ) / 2;
+  const unsigned int chroma_height = ( header_.height + 1 ) / 2;
+
+  read_plane( raster.get().Y(), header_.width, header_.height );
+  read_plane( raster.get().U(), chroma_width, chroma_height );
+  read_plane( raster.get().V(), chroma_width, chroma_height );
+
   RasterHandle handle( move( raster ) );
   return make_optional<RasterHandle>( true, handle );
 }
+
+void YUV4MPEGReader::read_frames( void )
+{
+  while ( frames_.wait_for_room() ) {
+    Optional<RasterHandle> frame;
+
+    try {
+      frame = read_frame();
+    } catch ( ... ) {
+      frames_.fail( current_exception() );
+      return;
+    }
+
+    if ( not frame.initialized() ) {
+      frames_.finish();
+      return;
+    }
+
+    frames_.push( move( frame.get() ) );
+  }
+}
+
+Optional<RasterHandle> YUV4MPEGReader::get_next_frame()
+{
+  return frames_.pop();
+}
@@ -1,11 +1,20 @@
 #ifndef YUV4MPEG_HH
 #define YUV4MPEG_HH
 
+#include <sys/uio.h>
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <thread>
+
 #include "frame_input.hh"
 #include "exception.hh"
 #include "raster_handle.hh"
 #include "file_descriptor.hh"
 #include "vp8_raster.hh"
+#include "mmap_region.hh"
+#include "bounded_queue.hh"
 
 class YUV4MPEGHeader
 {
@@ -31,17 +40,55 @@ public:
   size_t uv_plane_length();
 };
 
+/* Reads frames on a background thread, a couple ahead of get_next_frame().
+   A regular file is mapped and each row copied out of the mapping with
+   one memcpy; anything else (a pipe) has its frame headers read through
+   a buffered window and its planes read straight into the raster's rows. */
 class YUV4MPEGReader : public FrameInput
 {
 private:
+  static constexpr unsigned int prefetch_depth = 2;
+  static constexpr size_t window_size = 1 << 20;
+
   YUV4MPEGHeader header_;
   FileDescriptor fd_;
 
+  /* written to on destruction, to wake the reader if it is waiting on fd_ */
+  std::pair<FileDescriptor, FileDescriptor> wakeup_;
+
+  std::unique_ptr<MMap_Region> mapping_ {};
+  const uint8_t * mapped_ { nullptr };
+  uint64_t mapped_size_ { 0 };
+  uint64_t position_ { 0 };
+
+  std::vector<uint8_t> window_ {};
+  size_t window_begin_ { 0 };
+  size_t window_end_ { 0 };
+
+  std::vector<iovec> iovecs_ {};
+
+  BoundedQueue<RasterHandle> frames_ { prefetch_depth };
+
+  std::thread reader_ {};
+
   static std::pair< size_t, size_t > parse_fraction( const std::string & fraction_str );
 
+  /* waits until fd_ can be read, throwing if the reader is shutting down */
+  void wait_for_input( void );
+
+  /* false at the end of the input */
+  bool read_line( std::string & line );
+  bool fill_window( void );
+  void read_plane( TwoD<uint8_t> & plane, const unsigned int width, const unsigned int height );
+
+  Optional<RasterHandle> read_frame( void );
+  void read_frames( void );
+
 public:
   YUV4MPEGReader( FileDescriptor && fd );
   YUV4MPEGReader( const std::string & filename );
+  ~YUV4MPEGReader();
+
   Optional<RasterHandle> get_next_frame() override;
 
   uint16_t display_width() override { return header_.width; }
@@ -50,6 +97,10 @@ public:
   size_t frame_length() { return header_.frame_length(); }
   size_t y_plane_length() { return header_.y_plane_length(); }
   size_t uv_plane_length() { return header_.uv_plane_length(); }
+
+  /* forbid copying or moving */
+  YUV4MPEGReader( const YUV4MPEGReader & other ) = delete;
+  YUV4MPEGReader & operator=( const YUV4MPEGReader & other ) = delete;
 };
 
 #endif /* YUV4MPEG_HH */
@@ -1,22 +1,271 @@
+#include <getopt.h>
+
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <memory>
 
 #include "player.hh"
+#include "ivf.hh"
+#include "thread_pool.hh"
+#include "decode_timer.hh"
+#include "pipelined_parser.hh"
+#include "raster_writer.hh"
 
 using namespace std;
 
+void usage_error( const string & program_name )
+{
+  cerr << "Usage: " << program_name << " [options] <input>" << endl
+       << endl
+       << "Options:" << endl
+       << " -t <arg>, --threads=<arg>             Decoding threads (default: 1, 0 = one per core)" << endl
+       << " -p <arg>, --parse-ahead=<arg>         Frames to parse ahead on a separate thread (default: 0 = off)" << endl
+       << " -k <arg>, --checkpoint-interval=<arg> Save a decoder checkpoint every <arg> frames (default: 0 = off)" << endl
+       << " -d <arg>, --checkpoint-dir=<arg>      Directory for checkpoints (default: .)" << endl
+       << " -r <arg>, --resume=<arg>              Resume decoding from a checkpoint file" << endl
+       << " -b <arg>, --bench=<arg>               Decode <arg> times from memory and print timings as JSON" << endl
+       << " -o <arg>, --output=<arg>              Write the decoded frames to <arg> (- for standard output)," << endl
+       << "                                       as YUV4MPEG2 if it ends in .y4m and raw I420 otherwise" << endl
+       << " -y, --y4m                             Write YUV4MPEG2 whatever the output is called" << endl;
+}
+
+/* s as a JSON string literal, quotes included */
+static string json_string( const string & s )
+{
+  ostringstream out;
+  out << '"';
+
+  for ( const char c : s ) {
+    switch ( c ) {
+    case '"': out << "\\\""; break;
+    case '\\': out << "\\\\"; break;
+    case '\n': out << "\\n"; break;
+    case '\t': out << "\\t"; break;
+    default:
+      if ( static_cast<unsigned char>( c ) < 0x20 ) {
+        out << "\\u" << hex << setw( 4 ) << setfill( '0' ) << int( c );
+      } else {
+        out << c;
+      }
+    }
+  }
+
+  out << '"';
+  return out.str();
+}
+
+/* Decodes the whole file iterations times from a copy in memory, hashing
+   every shown frame, and prints the throughput and the time spent in
+   each stage. With several threads, stage times are summed over them. */
+void bench( const string & filename, const unsigned int iterations,
+            const unsigned int threads, const unsigned int parse_ahead )
+{
+  const IVF file( filename );
+
+  if ( file.fourcc() != "VP80" ) {
+    throw Unsupported( "not a VP8 file" );
+  }
+
+  /* from the first key frame on, as the player would */
+  vector<vector<uint8_t>> frames;
+  for ( unsigned int i = 0; i < file.frame_count(); i++ ) {
+    const Chunk frame = file.frame( i );
+    if ( frames.empty() and not UncompressedChunk( frame, file.width(), file.height() ).key_frame() ) {
+      continue;
+    }
+    frames.emplace_back( frame.buffer(), frame.buffer() + frame.size() );
+  }
+
+  DecodeTimer::reset();
+  DecodeTimer::enable( true );
+
+  chrono::nanoseconds elapsed { 0 };
+
+  /* over all iterations */
+  uint64_t shown_frames = 0;
+
+  for ( unsigned int iteration = 0; iteration < iterations; iteration++ ) {
+    Decoder decoder( file.width(), file.height() );
+    decoder.set_thread_count( threads );
+
+    const auto start = chrono::steady_clock::now();
+
+    if ( parse_ahead ) {
+      vector<Chunk> chunks( frames.begin(), frames.end() );
+      PipelinedParser parser( move( chunks ), decoder, parse_ahead );
+
+      for ( Optional<pair<bool, RasterHandle>> output = parser.decode_next( decoder );
+            output.initialized();
+            output = parser.decode_next( decoder ) ) {
+        if ( output.get().first ) {
+          output.get().second.hash();
+          shown_frames++;
+        }
+      }
+    } else {
+      for ( const vector<uint8_t> & frame : frames ) {
+        const pair<bool, RasterHandle> output = decoder.get_frame_output( frame );
+        if ( output.first ) {
+          output.second.hash();
+          shown_frames++;
+        }
+      }
+    }
+
+    elapsed += chrono::steady_clock::now() - start;
+  }
+
+  DecodeTimer::enable( false );
+
+  const uint64_t macroblocks = uint64_t( frames.size() ) * iterations
+    * VP8Raster::macroblock_dimension( file.width() ) * VP8Raster::macroblock_dimension( file.height() );
+  const double seconds = chrono::duration<double>( elapsed ).count();
+
+  const auto per_macroblock = [&] ( const uint64_t nanoseconds ) {
+    return macroblocks ? double( nanoseconds ) / macroblocks : 0.0;
+  };
+
+  cout << fixed << setprecision( 3 );
+  cout << "{" << endl
+       << "  \"file\": " << json_string( filename ) << "," << endl
+       << "  \"width\": " << file.width() << "," << endl
+       << "  \"height\": " << file.height() << "," << endl
+       << "  \"frames_per_iteration\": " << frames.size() << "," << endl
+       << "  \"shown_frames_per_iteration\": " << shown_frames / iterations << "," << endl
+       << "  \"iterations\": " << iterations << "," << endl
+       << "  \"threads\": " << threads << "," << endl
+       << "  \"parse_ahead\": " << parse_ahead << "," << endl
+       << "  \"seconds\": " << seconds << "," << endl
+       << "  \"fps\": " << ( seconds > 0 ? frames.size() * iterations / seconds : 0.0 ) << "," << endl
+       << "  \"ns_per_macroblock\": " << per_macroblock( elapsed.count() ) << "," << endl
+       << "  \"stages_ns_per_macroblock\": {" << endl;
+
+  for ( unsigned int i = 0; i < num_decode_stages; i++ ) {
+    const DecodeStage stage = static_cast<DecodeStage>( i );
+    cout << "    \"" << DecodeTimer::name( stage ) << "\": " << per_macroblock( DecodeTimer::nanoseconds( stage ) )
+         << ( i + 1 < num_decode_stages ? "," : "" ) << endl;
+  }
+
+  cout << "  }" << endl
+       << "}" << endl;
+}
+
 int main( int argc, char *argv[] )
 {
   try {
-    if ( argc != 2 ) {
-      cerr << "Usage: " << argv[ 0 ] << " FILENAME" << endl;
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    unsigned int threads = 1;
+    unsigned int parse_ahead = 0;
+    unsigned int checkpoint_interval = 0;
+    string checkpoint_dir = ".";
+    string resume_from;
+    unsigned int bench_iterations = 0;
+    string output_filename;
+    bool force_y4m = false;
+
+    const option command_line_options[] = {
+      { "threads", required_argument, nullptr, 't' },
+      { "parse-ahead", required_argument, nullptr, 'p' },
+      { "checkpoint-interval", required_argument, nullptr, 'k' },
+      { "checkpoint-dir", required_argument, nullptr, 'd' },
+      { "resume", required_argument, nullptr, 'r' },
+      { "bench", required_argument, nullptr, 'b' },
+      { "output", required_argument, nullptr, 'o' },
+      { "y4m", no_argument, nullptr, 'y' },
+      { 0, 0, nullptr, 0 }
+    };
+
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "t:p:k:d:r:b:o:y", command_line_options, nullptr );
+
+      if ( opt == -1 ) {
+        break;
+      }
+
+      switch ( opt ) {
+      case 't':
+        threads = stoul( optarg );
+        break;
+
+      case 'p':
+        parse_ahead = stoul( optarg );
+        break;
+
+      case 'k':
+        checkpoint_interval = stoul( optarg );
+        break;
+
+      case 'd':
+        checkpoint_dir = optarg;
+        break;
+
+      case 'r':
+        resume_from = optarg;
+        break;
+
+      case 'b':
+        bench_iterations = stoul( optarg );
+        break;
+
+      case 'o':
+        output_filename = optarg;
+        break;
+
+      case 'y':
+        force_y4m = true;
+        break;
+
+      default:
+        usage_error( argv[ 0 ] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    if ( optind != argc - 1 ) {
+      usage_error( argv[ 0 ] );
       return EXIT_FAILURE;
     }
 
-    Player player( argv[ 1 ] );
+    if ( bench_iterations ) {
+      bench( argv[ optind ], bench_iterations, threads ? threads : ThreadPool::default_concurrency(), parse_ahead );
+      return EXIT_SUCCESS;
+    }
 
+    Player player( argv[ optind ] );
+    player.set_thread_count( threads ? threads : ThreadPool::default_concurrency() );
+    player.set_checkpoint_interval( checkpoint_interval, checkpoint_dir );
+
+    if ( not resume_from.empty() ) {
+      player.resume( resume_from );
+    }
+
+    player.set_parse_ahead( parse_ahead );
+
+    unique_ptr<RasterWriter> output;
+    if ( not output_filename.empty() ) {
+      const IVF file( argv[ optind ] );
+      const RasterWriter::Format format = force_y4m ? RasterWriter::Format::YUV4MPEG
+                                                    : RasterWriter::format_for( output_filename );
+      const uint32_t fps_denominator = max( file.time_scale(), 1u );
+
+      if ( output_filename == "-" ) {
+        output.reset( new RasterWriter( FileDescriptor( STDOUT_FILENO ), format, file.frame_rate(), fps_denominator ) );
+      } else {
+        output.reset( new RasterWriter( output_filename, format, file.frame_rate(), fps_denominator ) );
+      }
+    }
 
     while ( not player.eof() ) {
-      player.advance();
+      const RasterHandle raster = player.advance();
+
+      if ( output ) {
+        output->write( raster );
+      }
     }
 
   } catch ( const exception & e ) {
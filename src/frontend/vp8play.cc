@@ -1,25 +1,130 @@
+#include <getopt.h>
+
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
 
-#include "player.hh"
+#include "ivf.hh"
+#include "decode_ahead.hh"
 #include "display.hh"
+#include "thread_pool.hh"
 
 using namespace std;
 
+void usage_error( const string & program_name )
+{
+  cerr << "Usage: " << program_name << " [options] <input>" << endl
+       << endl
+       << "Options:" << endl
+       << " -a <arg>, --decode-ahead=<arg>        Frames to decode ahead of the display (default: 4)" << endl
+       << " -t <arg>, --threads=<arg>             Decoding threads (default: 1, 0 = one per core)" << endl
+       << " -f, --free-run                        Show frames as fast as they are decoded, not at the file's frame rate" << endl;
+}
+
 int main( int argc, char *argv[] )
 {
   try {
-    if ( argc != 2 ) {
-      cerr << "Usage: " << argv[ 0 ] << " FILENAME" << endl;
+    if ( argc <= 0 ) {
+      abort();
+    }
+
+    unsigned int decode_ahead = 4;
+    unsigned int threads = 1;
+    bool free_run = false;
+
+    const option command_line_options[] = {
+      { "decode-ahead", required_argument, nullptr, 'a' },
+      { "threads", required_argument, nullptr, 't' },
+      { "free-run", no_argument, nullptr, 'f' },
+      { 0, 0, nullptr, 0 }
+    };
+
+    while ( true ) {
+      const int opt = getopt_long( argc, argv, "a:t:f", command_line_options, nullptr );
+
+      if ( opt == -1 ) {
+        break;
+      }
+
+      switch ( opt ) {
+      case 'a':
+        decode_ahead = stoul( optarg );
+        break;
+
+      case 't':
+        threads = stoul( optarg );
+        break;
+
+      case 'f':
+        free_run = true;
+        break;
+
+      default:
+        usage_error( argv[ 0 ] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    if ( optind != argc - 1 or decode_ahead == 0 ) {
+      usage_error( argv[ 0 ] );
       return EXIT_FAILURE;
     }
 
-    Player player( argv[ 1 ] );
+    /* each frame is shown for time_scale / frame_rate seconds */
+    chrono::nanoseconds frame_duration { 0 };
+    {
+      const IVF file( argv[ optind ] );
+      if ( not free_run and file.frame_rate() > 0 ) {
+        frame_duration = chrono::nanoseconds( 1000000000ull * max( file.time_scale(), 1u ) / file.frame_rate() );
+      }
+    }
+
+    DecodeAhead decoder( argv[ optind ], decode_ahead,
+                         threads ? threads : ThreadPool::default_concurrency() );
+
+    VideoDisplay display { decoder.example_raster() };
+
+    unsigned int shown_frames = 0, dropped_frames = 0;
+    chrono::nanoseconds total_decode_latency { 0 }, max_decode_latency { 0 };
+
+    chrono::steady_clock::time_point start;
 
-    VideoDisplay display { player.example_raster() };
+    for ( unsigned int frame_index = 0; not display.window().should_close(); frame_index++ ) {
+      Optional<DecodeAhead::DecodedFrame> frame = decoder.next();
+      if ( not frame.initialized() ) {
+        break;
+      }
 
-    while ( not player.eof() ) {
-      display.draw( player.advance() );
+      total_decode_latency += frame.get().decode_latency;
+      max_decode_latency = max( max_decode_latency, frame.get().decode_latency );
+
+      if ( frame_index == 0 ) {
+        start = chrono::steady_clock::now();
+      }
+
+      const chrono::steady_clock::time_point deadline = start + frame_index * frame_duration;
+
+      /* a frame whose whole period has already passed is not worth uploading */
+      if ( frame_duration.count() > 0 and chrono::steady_clock::now() > deadline + frame_duration ) {
+        dropped_frames++;
+        continue;
+      }
+
+      /* let the upload proceed while we wait for the frame's turn */
+      display.upload( frame.get().raster );
+      this_thread::sleep_until( deadline );
+      display.repaint();
+      shown_frames++;
     }
+
+    const unsigned int decoded_frames = shown_frames + dropped_frames;
+    const auto milliseconds = [] ( const chrono::nanoseconds & duration ) { return duration.count() / 1.0e6; };
+
+    cerr << "Shown " << shown_frames << " frames, dropped " << dropped_frames << "; decode latency "
+         << fixed << setprecision( 2 )
+         << milliseconds( decoded_frames ? total_decode_latency / decoded_frames : chrono::nanoseconds( 0 ) )
+         << " ms mean, " << milliseconds( max_decode_latency ) << " ms max" << endl;
   } catch ( const exception & e ) {
     print_exception( argv[ 0 ], e );
     return EXIT_FAILURE;
@@ -3,9 +3,11 @@
 #include <array>
 #include <string>
 #include <iomanip>
+#include <chrono>
 
 #include "frame.hh"
 #include "decoder.hh"
+#include "frame_scanner.hh"
 #include "ivf.hh"
 
 using namespace std;
@@ -18,6 +20,10 @@ void usage_error( const string & program_name )
        << " -m, --macroblocks              Print per-macroblock information" << endl
        << " -p, --probability-tables       Print the prob tables for each frame" << endl
        << " -c, --coefficients             Print DCT coefficients for each block" << endl
+       << " -s, --scan                     Summarize every frame from its headers alone (with -m," << endl
+       << "                                also count macroblock modes and references)" << endl
+       << " -i, --index                    Write <ivf>.index, which later opens of <ivf> load" << endl
+       << "                                instead of walking every frame header" << endl
        << endl;
 }
 
@@ -36,7 +42,7 @@ void print_probability_tables( const Frame & frame, const DecoderState & state )
             cout << ( int )node.get() << "\t";
           }
           else {
-            cout << ( int )state.probability_tables.coeff_probs.at( i ).at( j ).at( k ).at( l ) << "\t";
+            cout << ( int )state.probability_tables->coeff_probs.at( i ).at( j ).at( k ).at( l ) << "\t";
           }
         }
 
@@ -53,6 +59,100 @@ static array<string, 10> bmode_names =
   { "B_DC_PRED", "B_TM_PRED", "B_VE_PRED", "B_HE_PRED", "B_LD_PRED",
     "B_RD_PRED", "B_VR_PRED", "B_VL_PRED", "B_HD_PRED", "B_HU_PRED" };
 
+static array<string, 10> all_mbmode_names =
+  { "DC_PRED", "V_PRED", "H_PRED", "TM_PRED", "B_PRED",
+    "NEARESTMV", "NEARMV", "ZEROMV", "NEWMV", "SPLITMV" };
+
+static array<string, 4> reference_names =
+  { "intra", "last", "golden", "altref" };
+
+template <class Names, class Counts>
+void print_histogram( const string & title, const Names & names, const Counts & counts )
+{
+  cout << "  " << setw( 10 ) << left << title;
+  for ( unsigned int i = 0; i < counts.size(); i++ ) {
+    if ( counts.at( i ) ) {
+      cout << " " << names.at( i ) << "=" << counts.at( i );
+    }
+  }
+  cout << endl;
+}
+
+/* one line per frame from its headers, then totals; nothing is decoded */
+int scan( const IVF & ivf, const bool macroblocks )
+{
+  FrameScanner scanner( ivf.width(), ivf.height(), macroblocks );
+
+  FrameSummary totals;
+  uint64_t key_frames = 0;
+  chrono::nanoseconds elapsed { 0 };
+
+  for ( size_t frame_number = 0; frame_number < ivf.frame_count(); frame_number++ ) {
+    const auto start = chrono::steady_clock::now();
+    const FrameSummary summary = scanner.scan( ivf.frame( frame_number ) );
+    elapsed += chrono::steady_clock::now() - start;
+
+    cout << "Frame #" << frame_number
+         << ( summary.key_frame ? " key" : summary.experimental ? " experimental" : " inter" )
+         << ( summary.shown ? "" : " (hidden)" )
+         << " size=" << summary.size
+         << " first_partition=" << summary.first_partition_size
+         << " y_ac_qi=" << (int)summary.y_ac_qi
+         << " loop_filter_level=" << (int)summary.loop_filter_level;
+
+    const UpdateTracker & updates = summary.updates;
+    cout << " refresh=" << ( updates.update_last ? "L" : "" ) << ( updates.update_golden ? "G" : "" )
+         << ( updates.update_alternate ? "A" : "" )
+         << ( updates.last_to_golden ? " last->golden" : "" )
+         << ( updates.alternate_to_golden ? " altref->golden" : "" )
+         << ( updates.last_to_alternate ? " last->altref" : "" )
+         << ( updates.golden_to_alternate ? " golden->altref" : "" ) << endl;
+
+    if ( macroblocks and not summary.experimental ) {
+      print_histogram( "reference", reference_names, summary.macroblocks_by_reference );
+      print_histogram( "y_mode", all_mbmode_names, summary.y_modes );
+      print_histogram( "uv_mode", mbmode_names, summary.uv_modes );
+      print_histogram( "b_mode", bmode_names, summary.b_modes );
+    }
+
+    key_frames += summary.key_frame;
+    totals.size += summary.size;
+    totals.first_partition_size += summary.first_partition_size;
+    for ( unsigned int i = 0; i < totals.macroblocks_by_reference.size(); i++ ) {
+      totals.macroblocks_by_reference.at( i ) += summary.macroblocks_by_reference.at( i );
+    }
+    for ( unsigned int i = 0; i < totals.y_modes.size(); i++ ) {
+      totals.y_modes.at( i ) += summary.y_modes.at( i );
+    }
+    for ( unsigned int i = 0; i < totals.uv_modes.size(); i++ ) {
+      totals.uv_modes.at( i ) += summary.uv_modes.at( i );
+    }
+    for ( unsigned int i = 0; i < totals.b_modes.size(); i++ ) {
+      totals.b_modes.at( i ) += summary.b_modes.at( i );
+    }
+  }
+
+  cout << endl << "Total: " << ivf.frame_count() << " frames (" << key_frames << " key), "
+       << totals.size << " bytes, " << totals.first_partition_size << " in first partitions" << endl;
+
+  if ( macroblocks ) {
+    print_histogram( "reference", reference_names, totals.macroblocks_by_reference );
+    print_histogram( "y_mode", all_mbmode_names, totals.y_modes );
+    print_histogram( "uv_mode", mbmode_names, totals.uv_modes );
+    print_histogram( "b_mode", bmode_names, totals.b_modes );
+  }
+
+  const double seconds = chrono::duration<double>( elapsed ).count();
+  cerr << "Scanned in " << seconds * 1000 << " ms";
+  if ( ivf.frame_rate() and seconds > 0 ) {
+    const double duration = double( ivf.frame_count() ) * ivf.time_scale() / ivf.frame_rate();
+    cerr << " (" << duration / seconds << "x real time)";
+  }
+  cerr << endl;
+
+  return EXIT_SUCCESS;
+}
+
 int main( int argc, char *argv[] )
 {
   if ( argc <= 0 ) {
@@ -67,16 +167,20 @@ int main( int argc, char *argv[] )
   bool probability_tables = false;
   bool coefficients = false;
   bool macroblocks = false;
+  bool scan_only = false;
+  bool write_index = false;
 
   const option command_line_options[] = {
     { "macroblocks",               no_argument, nullptr, 'm' },
     { "probability-tables",        no_argument, nullptr, 'p' },
     { "coefficients",              no_argument, nullptr, 'c' },
+    { "scan",                      no_argument, nullptr, 's' },
+    { "index",                     no_argument, nullptr, 'i' },
     { 0, 0, nullptr, 0 }
   };
 
   while ( true ) {
-    const int opt = getopt_long( argc, argv, "pc", command_line_options, nullptr );
+    const int opt = getopt_long( argc, argv, "mpcsi", command_line_options, nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -85,6 +189,7 @@ int main( int argc, char *argv[] )
     switch ( opt ) {
     case 'm':
       macroblocks = true;
+      break;
 
     case 'p':
       probability_tables = true;
@@ -94,6 +199,14 @@ int main( int argc, char *argv[] )
       coefficients = true;
       break;
 
+    case 's':
+      scan_only = true;
+      break;
+
+    case 'i':
+      write_index = true;
+      break;
+
     default:
       throw runtime_error( "getopt_long: unexpected return value." );
     }
@@ -108,6 +221,15 @@ int main( int argc, char *argv[] )
 
   const IVF ivf( video_file );
 
+  if ( write_index ) {
+    ivf.write_index( IVF::index_filename( video_file ) );
+    return EXIT_SUCCESS;
+  }
+
+  if ( scan_only ) {
+    return scan( ivf, macroblocks );
+  }
+
   uint16_t width = ivf.width();
   uint16_t height = ivf.height();
 
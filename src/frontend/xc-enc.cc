@@ -16,6 +16,7 @@
 #include "macroblock.hh"
 #include "ivf_writer.hh"
 #include "display.hh"
+#include "thread_pool.hh"
 
 using namespace std;
 
@@ -26,10 +27,14 @@ void usage_error( const string & program_name )
        << "Options:" << endl
        << " -o <arg>, --output=<arg>              Output file name (default: output.ivf)" << endl
        << " -s <arg>, --ssim=<arg>                SSIM for the output" << endl
+       << " --ssim-all-planes                     Apply --ssim to the combined SSIM of Y, U and V" << endl
        << " -i <arg>, --input-format=<arg>        Input file format" << endl
        << "                                         ivf (default), y4m" << endl
        << " --two-pass                            Do the second encoding pass" << endl
-       << " --y-ac-qi <arg>                       Quantization index for Y" << endl;
+       << " --y-ac-qi <arg>                       Quantization index for Y" << endl
+       << " -t <arg>, --threads=<arg>             Loop filter threads (default: 1, 0 = one per core)" << endl
+       << " --output-sync <arg>                   How output reaches storage:" << endl
+       << "                                         none (default), datasync (after every batch), direct (O_DIRECT)" << endl;
 }
 
 int main( int argc, char *argv[] )
@@ -48,20 +53,26 @@ int main( int argc, char *argv[] )
     string input_format = "ivf";
     double ssim = 0.99;
     bool two_pass = false;
+    bool ssim_all_planes = false;
 
     size_t y_ac_qi = numeric_limits<size_t>::max();
+    unsigned int threads = 1;
+    IVFWriter::Durability durability = IVFWriter::Durability::None;
 
     const option command_line_options[] = {
       { "output",       required_argument, nullptr, 'o' },
       { "input-format", required_argument, nullptr, 'i' },
       { "ssim",         required_argument, nullptr, 's' },
+      { "ssim-all-planes", no_argument,    nullptr, 'A' },
       { "two-pass",     no_argument,       nullptr, '2' },
       { "y-ac-qi",      required_argument, nullptr, 'y' },
+      { "threads",      required_argument, nullptr, 't' },
+      { "output-sync",  required_argument, nullptr, 'S' },
       { 0, 0, nullptr, 0 }
     };
 
     while ( true ) {
-      const int opt = getopt_long( argc, argv, "o:i:s:", command_line_options, nullptr );
+      const int opt = getopt_long( argc, argv, "o:i:s:t:", command_line_options, nullptr );
 
       if ( opt == -1 ) {
         break;
@@ -84,10 +95,31 @@ int main( int argc, char *argv[] )
         two_pass = true;
         break;
 
+      case 'A':
+        ssim_all_planes = true;
+        break;
+
       case 'y':
         y_ac_qi = stoul( optarg );
         break;
 
+      case 't':
+        threads = stoul( optarg );
+        break;
+
+      case 'S':
+        if ( string( optarg ) == "none" ) {
+          durability = IVFWriter::Durability::None;
+        } else if ( string( optarg ) == "datasync" ) {
+          durability = IVFWriter::Durability::DataSync;
+        } else if ( string( optarg ) == "direct" ) {
+          durability = IVFWriter::Durability::Direct;
+        } else {
+          usage_error( argv[ 0 ] );
+          return EXIT_FAILURE;
+        }
+        break;
+
       default:
         throw runtime_error( "getopt_long: unexpected return value." );
       }
@@ -102,7 +134,7 @@ int main( int argc, char *argv[] )
 
     if ( input_format == "ivf" ) {
       if ( input_file == "-" ) {
-        throw runtime_error( "not supported" );
+        input_reader = make_shared<IVFReader>( FileDescriptor( STDIN_FILENO ) );
       }
       else {
         input_reader = make_shared<IVFReader>( input_file );
@@ -123,7 +155,10 @@ int main( int argc, char *argv[] )
     Encoder encoder( output_file,
                      input_reader->display_width(),
                      input_reader->display_height(),
-                     two_pass );
+                     two_pass, durability );
+
+    encoder.set_thread_count( threads ? threads : ThreadPool::default_concurrency() );
+    encoder.set_ssim_all_planes( ssim_all_planes );
 
     Optional<RasterHandle> raster = input_reader->get_next_frame();
 
@@ -136,6 +171,8 @@ int main( int argc, char *argv[] )
 
       raster = input_reader->get_next_frame();
     }
+
+    encoder.finish();
   } catch ( const exception &  e ) {
     print_exception( argv[ 0 ], e );
     return EXIT_FAILURE;
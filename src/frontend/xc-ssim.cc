@@ -6,6 +6,7 @@
 #include "yuv4mpeg.hh"
 #include "ivf_reader.hh"
 #include "raster_handle.hh"
+#include "thread_pool.hh"
 
 using namespace std;
 
@@ -14,7 +15,8 @@ void usage_error( const string & program_name )
   cerr << "Usage: " << program_name << " [options] <video1> <video2>" << endl
        << endl
        << "Options:" << endl
-       << " -a,       --all-planes                Output SSIM for all planes" << endl
+       << " -a,       --all-planes                Also output U and V SSIM, combined SSIM and PSNR" << endl
+       << " -t <arg>, --threads=<arg>             Threads to measure with (default: all cores)" << endl
        << " -1 <arg>, --video1-format=<arg>       First video input format"   << endl
        << " -2 <arg>, --video2-format=<arg>       Second video input format"  << endl
        << "                                         ivf (default), y4m"       << endl;
@@ -34,16 +36,18 @@ int main( int argc, char *argv[] )
 
   string video_format[ 2 ];
   bool all_planes = false;
+  unsigned int threads = ThreadPool::default_concurrency();
 
   const option command_line_options[] = {
     { "all-planes",                no_argument, nullptr, 'a' },
     { "video1-format",       required_argument, nullptr, '1' },
     { "video2-format",       required_argument, nullptr, '2' },
+    { "threads",             required_argument, nullptr, 't' },
     { 0, 0, nullptr, 0 }
   };
 
   while ( true ) {
-    const int opt = getopt_long( argc, argv, "1:2:a", command_line_options, nullptr );
+    const int opt = getopt_long( argc, argv, "1:2:at:", command_line_options, nullptr );
 
     if ( opt == -1 ) {
       break;
@@ -62,6 +66,10 @@ int main( int argc, char *argv[] )
       all_planes = true;
       break;
 
+    case 't':
+      threads = stoul( optarg );
+      break;
+
     default:
       throw runtime_error( "getopt_long: unexpected return value." );
     }
@@ -88,17 +96,18 @@ int main( int argc, char *argv[] )
     }
   }
 
+  ThreadPool thread_pool( threads );
+
   Optional<RasterHandle> raster[] = { video_reader[ 0 ]->get_next_frame(),
                                       video_reader[ 1 ]->get_next_frame() };
 
   while ( raster[ 0 ].initialized() and raster[ 1 ].initialized() ) {
-    double y_ssim = ssim( raster[ 0 ].get().get().Y(), raster[ 1 ].get().get().Y() );
-    cout << y_ssim;
+    const RasterQuality quality = raster_quality( raster[ 0 ].get().get(), raster[ 1 ].get().get(), &thread_pool );
+    cout << quality.Y.ssim;
 
     if ( all_planes ) {
-      double u_ssim = ssim( raster[ 0 ].get().get().U(), raster[ 1 ].get().get().U() );
-      double v_ssim = ssim( raster[ 0 ].get().get().V(), raster[ 1 ].get().get().V() );
-      cout << "\t" << u_ssim << "\t" << v_ssim;
+      cout << "\t" << quality.U.ssim << "\t" << quality.V.ssim
+           << "\t" << quality.ssim() << "\t" << quality.psnr();
     }
 
     cout << endl;
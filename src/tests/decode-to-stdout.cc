@@ -1,23 +1,32 @@
 #include <iostream>
 
 #include "player.hh"
+#include "raster_writer.hh"
 
 using namespace std;
 
 int main( int argc, char *argv[] )
 {
   try {
-    if ( argc != 2 ) {
-      cerr << "Usage: " << argv[ 0 ] << " FILENAME" << endl;
+    if ( argc < 2 or argc > 4 ) {
+      cerr << "Usage: " << argv[ 0 ] << " FILENAME [THREADS] [PARSE_AHEAD]" << endl;
       return EXIT_FAILURE;
     }
 
     Player player( argv[ 1 ] );
 
-    while ( not player.eof() ) {
-      RasterHandle raster = player.advance();
+    if ( argc >= 3 ) {
+      player.set_thread_count( stoul( argv[ 2 ] ) );
+    }
+
+    if ( argc == 4 ) {
+      player.set_parse_ahead( stoul( argv[ 3 ] ) );
+    }
+
+    RasterWriter output( FileDescriptor( STDOUT_FILENO ), RasterWriter::Format::Raw );
 
-      raster.get().dump( stdout );
+    while ( not player.eof() ) {
+      output.write( player.advance() );
     }
   } catch ( const exception & e ) {
     print_exception( argv[ 0 ], e );
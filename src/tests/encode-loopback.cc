@@ -56,6 +56,26 @@ int main( int argc, char *argv[] )
       }
     }
 
+    /* Short partitions end before the decoder's window is full */
+    for ( unsigned int length = 1; length < 100; length++ ) {
+      vector< pair< Probability, bool > > bitlist;
+      for ( unsigned int i = 0; i < length; i++ ) {
+	bitlist.emplace_back( probs( gen ), bits( gen ) );
+      }
+
+      const auto encoded_string = encode( bitlist );
+
+      BoolDecoder decoder( Chunk( &encoded_string.front(), encoded_string.size() ) );
+
+      for ( const auto & x : bitlist ) {
+	const bool this_bit = decoder.get( x.first );
+	if ( this_bit != x.second ) {
+	  cerr << "short partition of " << length << " bits: get( " << x.first << " ) got " << this_bit << ", expected " << x.second << endl;
+	  return EXIT_FAILURE;
+	}
+      }
+    }
+
     /* Now try some trees */
     for ( unsigned int trial = 0; trial < 200; trial++ ) {
       for ( mbmode i = mbmode( 0 ); i < num_y_modes; i = mbmode( i + 1 ) ) {
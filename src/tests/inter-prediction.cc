@@ -0,0 +1,94 @@
+#include <random>
+
+#include "exception.hh"
+#include "vp8_raster.hh"
+#include "vp8_header_structures.hh"
+
+using namespace std;
+
+/* Predicts every block of the given kind from a reference with random
+   pixels and checks that the result matches prediction from an
+   explicitly edge-clamped reference, whether the motion vector lands
+   inside the picture, in the border, or beyond it. */
+template <class BlockType, class lambda>
+static bool check_blocks( VP8Raster & prediction, const TwoD< uint8_t > & reference,
+			  default_random_engine & gen, const lambda & block_of )
+{
+  /* in eighth-pixels, reaching well past the border */
+  const int reach = 8 * ( 3 * BaseRaster::border );
+  uniform_int_distribution< int > offset( -reach, reach );
+
+  const EdgeExtendedRaster clamped_reference( reference );
+
+  bool ok = true;
+
+  for ( unsigned int mb_row = 0; mb_row < prediction.macroblock_height(); mb_row++ ) {
+    for ( unsigned int mb_column = 0; mb_column < prediction.macroblock_width(); mb_column++ ) {
+      VP8Raster::Macroblock macroblock = prediction.macroblock( mb_column, mb_row );
+      BlockType & block = block_of( macroblock );
+
+      for ( unsigned int trial = 0; trial < 50; trial++ ) {
+	const MotionVector mv( offset( gen ), offset( gen ) );
+
+	block.inter_predict( mv, reference );
+	SafeArray< uint8_t, 256 > fast;
+	block.contents().forall_ij( [&] ( const uint8_t & x, const unsigned int column, const unsigned int row )
+				    { fast.at( row * block.contents().width() + column ) = x; } );
+
+	block.safe_inter_predict( mv, clamped_reference,
+				  block.context().column * block.contents().width() + ( mv.x() >> 3 ),
+				  block.context().row * block.contents().height() + ( mv.y() >> 3 ) );
+
+	block.contents().forall_ij( [&] ( const uint8_t & x, const unsigned int column, const unsigned int row ) {
+	    if ( x != fast.at( row * block.contents().width() + column ) ) {
+	      cerr << "mismatch predicting " << block.contents().width() << "x" << block.contents().height()
+		   << " block at (" << block.context().column << ", " << block.context().row
+		   << ") with motion vector (" << mv.x() << ", " << mv.y() << ")" << endl;
+	      ok = false;
+	    }
+	  } );
+      }
+    }
+  }
+
+  return ok;
+}
+
+int main( int argc, char *argv[] )
+{
+  try {
+    if ( argc != 1 ) {
+      cerr << "Usage: " << argv[ 0 ] << endl;
+      return EXIT_FAILURE;
+    }
+
+    random_device rd;
+    default_random_engine gen( rd() );
+    uniform_int_distribution< unsigned int > pixels( 0, 255 );
+
+    VP8Raster reference( 80, 48 ), prediction( 80, 48 );
+
+    for ( TwoD< uint8_t > * plane : { &reference.Y(), &reference.U(), &reference.V() } ) {
+      plane->forall( [&] ( uint8_t & x ) { x = pixels( gen ); } );
+    }
+
+    reference.extend_borders();
+
+    const bool ok =
+      check_blocks< VP8Raster::Block16 >( prediction, reference.Y(), gen,
+					  [] ( VP8Raster::Macroblock & mb ) -> VP8Raster::Block16 & { return mb.Y; } )
+      and check_blocks< VP8Raster::Block8 >( prediction, reference.U(), gen,
+					     [] ( VP8Raster::Macroblock & mb ) -> VP8Raster::Block8 & { return mb.U; } )
+      and check_blocks< VP8Raster::Block4 >( prediction, reference.Y(), gen,
+					     [] ( VP8Raster::Macroblock & mb ) -> VP8Raster::Block4 & { return mb.Y_sub.at( 3, 2 ); } );
+
+    if ( not ok ) {
+      return EXIT_FAILURE;
+    }
+  } catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
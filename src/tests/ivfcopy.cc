@@ -17,9 +17,12 @@ int main( int argc, char *argv[] )
 		      old_file.width(),
 		      old_file.height(),
 		      old_file.frame_rate(),
-		      old_file.time_scale() );
+		      old_file.time_scale(),
+		      IVFWriter::Mode::Batched );
   
   for ( unsigned int i = 0; i < old_file.frame_count(); i++ ) {
     new_file.append_frame( old_file.frame( i ) );
   }
+
+  new_file.close();
 }
@@ -0,0 +1,90 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+
+#include "exception.hh"
+#include "raster_handle.hh"
+
+using namespace std;
+
+/* One thread allocates rasters and another frees them, as the decoder's
+   read-ahead threads do. Each raster must be handed out to one owner at
+   a time, the freed rasters must find their way back to the allocating
+   thread, and each thread should take the pool's lock only the first
+   time it sees the raster size. */
+int main( int argc, char *argv[] )
+{
+  try {
+    if ( argc != 1 ) {
+      cerr << "Usage: " << argv[ 0 ] << endl;
+      return EXIT_FAILURE;
+    }
+
+    const unsigned int frames = 1000, max_queued = 4;
+
+    RasterPool pool( 2, 8 );
+
+    mutex queue_mutex;
+    condition_variable queue_changed;
+    deque<MutableRasterHandle> queue;
+    set<const VP8Raster *> live;
+    bool reused_live_raster = false;
+
+    thread allocator( [&] () {
+        for ( unsigned int i = 0; i < frames; i++ ) {
+          MutableRasterHandle raster( 64, 48, pool );
+          raster.get().Y().at( 0, 0 ) = i;
+
+          unique_lock<mutex> lock( queue_mutex );
+          queue_changed.wait( lock, [&] () { return queue.size() < max_queued; } );
+          reused_live_raster |= not live.insert( &raster.get() ).second;
+          queue.push_back( move( raster ) );
+          queue_changed.notify_all();
+        }
+      } );
+
+    for ( unsigned int i = 0; i < frames; i++ ) {
+      unique_lock<mutex> lock( queue_mutex );
+      queue_changed.wait( lock, [&] () { return not queue.empty(); } );
+
+      MutableRasterHandle raster = move( queue.front() );
+      queue.pop_front();
+      if ( raster.get().Y().at( 0, 0 ) != uint8_t( i ) ) {
+        throw runtime_error( "raster overwritten while queued" );
+      }
+      live.erase( &raster.get() );
+      queue_changed.notify_all();
+
+      /* freed here, on a different thread from the one that allocated it */
+      lock.unlock();
+    }
+
+    allocator.join();
+
+    const RasterPool::Statistics statistics = pool.statistics();
+
+    if ( reused_live_raster ) {
+      throw runtime_error( "raster handed out while still in use" );
+    }
+
+    if ( statistics.hits + statistics.misses != frames ) {
+      throw runtime_error( "allocations miscounted" );
+    }
+
+    if ( statistics.misses > 2 * max_queued + 8 ) {
+      throw runtime_error( "freed rasters not recycled: " + to_string( statistics.misses ) + " misses" );
+    }
+
+    /* once for the allocating thread and once for the freeing thread */
+    if ( statistics.shard_lookups != 2 ) {
+      throw runtime_error( "size looked up under the lock " + to_string( statistics.shard_lookups ) + " times" );
+    }
+  } catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "player.hh"
+#include "file.hh"
+
+using namespace std;
+
+/* shown frames and the hashes of their output */
+using ShownFrames = vector<pair<unsigned int, size_t>>;
+
+/* Seeks to every shown frame with a new player each time, so that
+   decoding starts from a checkpoint in directory or from a key frame,
+   and returns how many seeks started somewhere other than
+   key_frame_starts says the key frame is. */
+static unsigned int checkpoint_seeks( const string & filename, const string & directory,
+                                      const ShownFrames & shown_frames,
+                                      const map<unsigned int, unsigned int> & key_frame_starts )
+{
+  unsigned int from_checkpoint = 0;
+
+  for ( const auto & frame : shown_frames ) {
+    Player player( filename );
+    player.set_checkpoint_interval( 2, directory );
+
+    if ( player.seek( frame.first ).hash() != frame.second ) {
+      throw runtime_error( "mismatch seeking from a checkpoint to frame " + to_string( frame.first ) );
+    }
+
+    if ( player.last_seek().start_frame != key_frame_starts.at( frame.first ) ) {
+      from_checkpoint++;
+    }
+  }
+
+  return from_checkpoint;
+}
+
+/* checkpoints before every other frame, saved (or brought up to date) by
+   a checkpointing player decoding the whole file */
+static void save_checkpoints( const string & filename, const string & directory )
+{
+  Player player( filename );
+  player.set_checkpoint_interval( 2, directory );
+  while ( not player.eof() ) {
+    player.advance();
+  }
+}
+
+/* Seeking to a frame, or resuming from a checkpoint, must produce what
+   decoding the file in order did, and leave the player where advance()
+   would have carried on from. Checkpoints are made of a copy of the
+   file, so that the copy can be rewritten to show that the checkpoints
+   of its earlier version are passed over and then replaced. */
+int main( int argc, char *argv[] )
+{
+  try {
+    if ( argc != 2 ) {
+      cerr << "Usage: " << argv[ 0 ] << " FILENAME" << endl;
+      return EXIT_FAILURE;
+    }
+
+    ShownFrames shown_frames;
+
+    {
+      Player player( argv[ 1 ] );
+      while ( not player.eof() ) {
+        const RasterHandle raster = player.advance();
+        shown_frames.emplace_back( player.cur_frame_no(), raster.hash() );
+      }
+    }
+
+    Player player( argv[ 1 ] );
+    chrono::nanoseconds total_latency { 0 };
+    unsigned int skipped = 0;
+    map<unsigned int, unsigned int> key_frame_starts;
+
+    /* backwards, so that every seek has to go back to a key frame */
+    for ( auto frame = shown_frames.rbegin(); frame != shown_frames.rend(); frame++ ) {
+      if ( player.seek( frame->first ).hash() != frame->second ) {
+        cerr << "Mismatch seeking to frame " << frame->first << endl;
+        return EXIT_FAILURE;
+      }
+
+      total_latency += player.last_seek().latency;
+      skipped += player.last_seek().frames_skipped;
+      key_frame_starts[ frame->first ] = player.last_seek().start_frame;
+
+      if ( frame != shown_frames.rbegin() and player.advance().hash() != prev( frame )->second ) {
+        cerr << "Mismatch advancing past frame " << frame->first << endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    char checkpoint_dir[] = "/tmp/seek-verify.XXXXXX";
+    if ( mkdtemp( checkpoint_dir ) == nullptr ) {
+      throw unix_error( "mkdtemp" );
+    }
+
+    const string copy_filename = string( checkpoint_dir ) + "/copy.ivf";
+    {
+      const File original( argv[ 1 ] );
+      FileDescriptor copy( SystemCall( copy_filename,
+                                       open( copy_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                                             S_IRUSR | S_IWUSR ) ) );
+      copy.write( original.chunk() );
+    }
+
+    save_checkpoints( copy_filename, checkpoint_dir );
+    const unsigned int from_checkpoint = checkpoint_seeks( copy_filename, checkpoint_dir,
+                                                           shown_frames, key_frame_starts );
+
+    /* as though the file had been rewritten */
+    const timespec long_ago[ 2 ] = { { 1, 0 }, { 1, 0 } };
+    SystemCall( "utimensat", utimensat( AT_FDCWD, copy_filename.c_str(), long_ago, 0 ) );
+
+    if ( checkpoint_seeks( copy_filename, checkpoint_dir, shown_frames, key_frame_starts ) != 0 ) {
+      cerr << "Seek started from a checkpoint of an earlier version of the file" << endl;
+      return EXIT_FAILURE;
+    }
+
+    save_checkpoints( copy_filename, checkpoint_dir );
+    if ( checkpoint_seeks( copy_filename, checkpoint_dir, shown_frames, key_frame_starts ) != from_checkpoint ) {
+      cerr << "Checkpoints of an earlier version of the file were not replaced" << endl;
+      return EXIT_FAILURE;
+    }
+
+    /* each checkpoint resumed from in turn */
+    Player checkpointing_player( copy_filename );
+    checkpointing_player.set_checkpoint_interval( 2, checkpoint_dir );
+
+    for ( auto frame = shown_frames.begin(); frame != shown_frames.end(); frame++ ) {
+      /* any checkpoint since the previous shown frame resumes to this one */
+      const unsigned int first_frame = frame == shown_frames.begin() ? 0 : prev( frame )->first + 1;
+
+      for ( unsigned int frame_no = first_frame; frame_no <= frame->first; frame_no++ ) {
+        const string filename = checkpointing_player.checkpoint_filename( frame_no );
+        if ( access( filename.c_str(), F_OK ) != 0 ) {
+          continue;
+        }
+
+        Player resumed_player( copy_filename );
+        resumed_player.resume( filename );
+        if ( resumed_player.advance().hash() != frame->second ) {
+          cerr << "Mismatch resuming at frame " << frame_no << endl;
+          return EXIT_FAILURE;
+        }
+
+        SystemCall( "unlink", unlink( filename.c_str() ) );
+      }
+    }
+
+    SystemCall( "unlink", unlink( copy_filename.c_str() ) );
+    SystemCall( "rmdir", rmdir( checkpoint_dir ) );
+
+    if ( not shown_frames.empty() ) {
+      cerr << shown_frames.size() << " seeks, "
+           << chrono::duration<double, milli>( total_latency ).count() / shown_frames.size()
+           << " ms each on average, " << skipped << " frame(s) not reconstructed, "
+           << from_checkpoint << " started from a checkpoint" << endl;
+    }
+  } catch ( const exception & e ) {
+    print_exception( argv[ 0 ], e );
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
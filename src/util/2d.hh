@@ -2,18 +2,30 @@
 #define TWOD_HH
 
 #include <cassert>
+#include <cstddef>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <algorithm>
 
 #include "optional.hh"
 
+/* number of extra elements to allocate on every side of a TwoDStorage */
+struct TwoDBorder
+{
+  unsigned int size;
+};
+
 /* simple two-dimensional container */
 template <class T>
 class TwoDStorage
 {
 private:
   unsigned int width_, height_;
+
+  /* rows are stride_ elements apart, and element ( 0, 0 ) is at origin_ */
+  unsigned int border_, stride_, origin_;
+
   std::vector< T > storage_;
 
 public:
@@ -43,7 +55,9 @@ public:
 
   template< typename... Targs >
   TwoDStorage( const unsigned int width, const unsigned int height, Targs&&... Fargs )
-    : width_( width ), height_( height ), storage_()
+    : width_( width ), height_( height ),
+      border_( 0 ), stride_( width ), origin_( 0 ),
+      storage_()
   {
     assert( width > 0 );
     assert( height > 0 );
@@ -59,16 +73,75 @@ public:
     }
   }
 
+  /* destroy every element and construct it again in place, as the
+     constructor would, reusing the allocation */
+  template< typename... Targs >
+  void rebuild( Targs&&... Fargs )
+  {
+    assert( border_ == 0 );
+
+    storage_.clear();
+
+    for ( unsigned int row = 0; row < height_; row++ ) {
+      for ( unsigned int column = 0; column < width_; column++ ) {
+	const Context c( column, row, width_, height_, *this );
+	storage_.emplace_back( c, Fargs... );
+      }
+    }
+  }
+
+  /* default-constructed elements, surrounded by a border that
+     extend_border() fills by replicating the outermost elements */
+  TwoDStorage( const unsigned int width, const unsigned int height, const TwoDBorder border )
+    : width_( width ), height_( height ),
+      border_( border.size ), stride_( width + 2 * border.size ),
+      origin_( border.size * stride_ + border.size ),
+      storage_( stride_ * ( height + 2 * border.size ) )
+  {
+    assert( width > 0 );
+    assert( height > 0 );
+  }
+
   T & at( const unsigned int column, const unsigned int row )
   {
     assert( column < width_ and row < height_ );
-    return storage_[ row * width_ + column ];
+    return storage_[ origin_ + row * stride_ + column ];
   }
 
   const T & at( const unsigned int column, const unsigned int row ) const
   {
     assert( column < width_ and row < height_ );
-    return storage_[ row * width_ + column ];
+    return storage_[ origin_ + row * stride_ + column ];
+  }
+
+  /* like at(), but may reach up to border() elements outside the picture */
+  const T & extended_at( const int column, const int row ) const
+  {
+    assert( column >= -int( border_ ) and column < int( width_ + border_ ) );
+    assert( row >= -int( border_ ) and row < int( height_ + border_ ) );
+    return storage_[ origin_ + ptrdiff_t( row ) * stride_ + column ];
+  }
+
+  /* replicate the outermost rows and columns into the border */
+  void extend_border( void )
+  {
+    if ( border_ == 0 ) {
+      return;
+    }
+
+    for ( unsigned int row = 0; row < height_; row++ ) {
+      T * const row_start = &at( 0, row );
+      std::fill( row_start - border_, row_start, row_start[ 0 ] );
+      std::fill( row_start + width_, row_start + width_ + border_, row_start[ width_ - 1 ] );
+    }
+
+    const auto first_row = storage_.begin() + border_ * stride_;
+    const auto last_row = storage_.begin() + ( border_ + height_ - 1 ) * stride_;
+
+    for ( unsigned int i = 1; i <= border_; i++ ) {
+      std::copy( first_row, first_row + stride_, first_row - i * stride_ );
+      std::copy( last_row, last_row + stride_, last_row + i * stride_ );
+    }
   }
 
   Optional<const T *> maybe_at( const unsigned int column, const unsigned int row ) const
@@ -82,14 +155,19 @@ public:
 
   unsigned int width( void ) const { return width_; }
   unsigned int height( void ) const { return height_; }
+  unsigned int border( void ) const { return border_; }
+  unsigned int stride( void ) const { return stride_; }
 
+  /* iteration covers the whole storage, so only makes sense without a border */
   const_iterator begin( void ) const
   {
+    assert( border_ == 0 );
     return storage_.begin();
   }
 
   const_iterator end( void ) const
   {
+    assert( border_ == 0 );
     return storage_.end();
   }
 
@@ -160,6 +238,7 @@ public:
   {
     assert( width_ == other.width_ );
     assert( height_ == other.height_ );
+    assert( border_ == other.border_ );
     storage_ = other.storage_;
   }
 
@@ -185,8 +264,14 @@ public:
   T & at( const unsigned int column, const unsigned int row ) { return storage_->at( column, row ); }
   const T & at( const unsigned int column, const unsigned int row ) const { return storage_->at( column, row ); }
 
+  const T & extended_at( const int column, const int row ) const { return storage_->extended_at( column, row ); }
+
   unsigned int width( void ) const { return storage_->width(); }
   unsigned int height( void ) const { return storage_->height(); }
+  unsigned int border( void ) const { return storage_->border(); }
+  unsigned int stride( void ) const { return storage_->stride(); }
+
+  void extend_border( void ) { storage_->extend_border(); }
 
   template <class lambda>
   void forall( const lambda & f ) { storage_->forall( f ); }
@@ -223,6 +308,9 @@ public:
   TwoD( const TwoD & other ) = delete;
   TwoD & operator=( const TwoD & other ) = delete;
 
+  /* take over storage allocated elsewhere, e.g. by a pool */
+  explicit TwoD( std::shared_ptr<TwoDStorage<T>> && storage ) : storage_( std::move( storage ) ) { assert( storage_ ); }
+
   /* allow moving */
   TwoD( TwoD && other ) : storage_( std::move( other.storage_ ) ) {}
   TwoD & operator=( TwoD && other ) { storage_ = std::move( other.storage_ ); return *this; }
@@ -234,20 +322,22 @@ public:
   const std::shared_ptr<TwoDStorage<T>> & storage( void ) const { return storage_; }
 };
 
+/* a view into part of a TwoD, which must outlive it */
 template< class T, unsigned int sub_width, unsigned int sub_height >
 class TwoDSubRange
 {
 private:
-  std::shared_ptr<TwoDStorage<T>> master_;
+  /* not shared, so that views are cheap to make and copy */
+  TwoDStorage<T> * master_;
 
   unsigned int column_, row_;
 
 public:
   TwoDSubRange( const TwoD<T> & master, const unsigned int column, const unsigned int row )
-    : TwoDSubRange( master.storage(), column, row )
+    : TwoDSubRange( master.storage().get(), column, row )
   {}
 
-  TwoDSubRange( const std::shared_ptr<TwoDStorage<T>> & storage, const unsigned int column, const unsigned int row )
+  TwoDSubRange( TwoDStorage<T> * const storage, const unsigned int column, const unsigned int row )
     : master_( storage ), column_( column ), row_( row )
   {
     assert( column_ + sub_width <= master_->width() );
@@ -372,7 +462,7 @@ public:
     }
   }
 
-  unsigned int stride( void ) const { return master_->width(); }
+  unsigned int stride( void ) const { return master_->stride(); }
 };
 
 #endif /* TWOD_HH */
@@ -0,0 +1,140 @@
+#ifndef BOUNDED_QUEUE_HH
+#define BOUNDED_QUEUE_HH
+
+/* hands items from a producing thread to a consuming one, with at most
+   a fixed number of them waiting in between */
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cassert>
+
+#include "optional.hh"
+
+template <class T>
+class BoundedQueue
+{
+private:
+  const size_t capacity_;
+
+  std::mutex mutex_ {};
+  std::condition_variable item_pushed_ {};
+  std::condition_variable item_popped_ {};
+  std::deque<T> items_ {};
+  std::exception_ptr error_ {};
+  bool finished_ { false };
+  bool shutting_down_ { false };
+
+  /* with mutex_ held: the consumer has shut down, or either side has failed */
+  bool stopped( void ) const { return shutting_down_ or error_; }
+
+public:
+  BoundedQueue( const size_t capacity ) : capacity_( capacity )
+  {
+    assert( capacity_ > 0 );
+  }
+
+  /* Waits until another item would fit. Returns false, without waiting,
+     once the consumer has shut the queue down or failed. */
+  bool wait_for_room( void )
+  {
+    std::unique_lock<std::mutex> lock( mutex_ );
+    item_popped_.wait( lock, [&] () { return stopped() or items_.size() < capacity_; } );
+
+    return not stopped();
+  }
+
+  /* waits for room, then queues item; returns false, dropping it, once
+     the consumer has shut the queue down or failed */
+  bool push( T && item )
+  {
+    {
+      std::unique_lock<std::mutex> lock( mutex_ );
+      item_popped_.wait( lock, [&] () { return stopped() or items_.size() < capacity_; } );
+
+      if ( stopped() ) {
+        return false;
+      }
+
+      items_.push_back( std::move( item ) );
+    }
+    item_pushed_.notify_one();
+
+    return true;
+  }
+
+  /* the producer has nothing more to push */
+  void finish( void )
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      finished_ = true;
+    }
+    item_pushed_.notify_one();
+  }
+
+  /* The next item, waiting for it if need be. Returns nothing once the
+     producer has finished and every item has been taken, and rethrows
+     if the producer failed. */
+  Optional<T> pop( void )
+  {
+    Optional<T> item;
+
+    {
+      std::unique_lock<std::mutex> lock( mutex_ );
+      item_pushed_.wait( lock, [&] () { return finished_ or error_ or not items_.empty(); } );
+
+      if ( items_.empty() ) {
+        if ( error_ ) {
+          std::rethrow_exception( error_ );
+        }
+
+        return item;
+      }
+
+      item.initialize( std::move( items_.front() ) );
+      items_.pop_front();
+    }
+    item_popped_.notify_one();
+
+    return item;
+  }
+
+  /* the consumer wants nothing more; a waiting producer returns */
+  void shut_down( void )
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      shutting_down_ = true;
+    }
+    item_popped_.notify_all();
+  }
+
+  /* Either side stops on an error, which the other side gets: pop()
+     rethrows it once the queue is empty, and wait_for_room() and push()
+     return false, after which rethrow_failure() rethrows it. */
+  void fail( const std::exception_ptr & error )
+  {
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      error_ = error;
+    }
+    item_pushed_.notify_all();
+    item_popped_.notify_all();
+  }
+
+  void rethrow_failure( void )
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if ( error_ ) {
+      std::rethrow_exception( error_ );
+    }
+  }
+
+  /* forbid copying or moving */
+  BoundedQueue( const BoundedQueue & other ) = delete;
+  BoundedQueue & operator=( const BoundedQueue & other ) = delete;
+};
+
+#endif /* BOUNDED_QUEUE_HH */
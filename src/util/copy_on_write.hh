@@ -0,0 +1,57 @@
+#ifndef COPY_ON_WRITE_HH
+#define COPY_ON_WRITE_HH
+
+#include <memory>
+#include <cassert>
+
+/* A value shared by all copies of this object. Copying costs a reference
+   count; mutate() gives this copy a private duplicate first if any other
+   copy can still see the value. */
+template <class T>
+class CopyOnWrite
+{
+private:
+  std::shared_ptr<T> object_;
+
+  /* specialized for types that cannot be copy-constructed */
+  static std::shared_ptr<T> duplicate( const T & object ) { return std::make_shared<T>( object ); }
+
+public:
+  CopyOnWrite() : object_( std::make_shared<T>() ) {}
+
+  CopyOnWrite( T && object ) : object_( std::make_shared<T>( std::move( object ) ) ) {}
+
+  const T & get( void ) const { return *object_; }
+  const T * operator->( void ) const { return object_.get(); }
+  operator const T & () const { return *object_; }
+
+  T & mutate( void )
+  {
+    assert( object_ );
+
+    if ( object_.use_count() > 1 ) {
+      object_ = duplicate( *object_ );
+    }
+
+    return *object_;
+  }
+
+  /* A copy with a value of its own. The reference count says nothing
+     about what another thread did with a value it has let go of, so a
+     value handed to another thread must be unshared first. */
+  CopyOnWrite unshared( void ) const
+  {
+    CopyOnWrite ret( *this );
+    ret.object_ = duplicate( *object_ );
+    return ret;
+  }
+
+  bool operator==( const CopyOnWrite & other ) const
+  {
+    return object_ == other.object_ or *object_ == *other.object_;
+  }
+
+  bool operator!=( const CopyOnWrite & other ) const { return not operator==( other ); }
+};
+
+#endif /* COPY_ON_WRITE_HH */
@@ -22,6 +22,7 @@ public:
   File( FileDescriptor && fd );
 
   const Chunk & chunk( void ) const { return chunk_; }
+  uint64_t modification_time( void ) const { return fd_.modification_time(); }
   const Chunk operator() ( const uint64_t & offset, const uint64_t & length ) const
   {
     return chunk_( offset, length );
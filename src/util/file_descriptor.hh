@@ -2,8 +2,14 @@
 #define FILE_DESCRIPTOR_HH
 
 #include <string>
+#include <vector>
+#include <functional>
 #include <unistd.h>
+#include <fcntl.h>
+#include <climits>
+#include <cstdio>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <algorithm>
 
 #include "exception.hh"
@@ -15,6 +21,39 @@ private:
   int fd_;
   bool eof_ { false };
 
+  /* Calls transfer (a readv or writev) until every iovec is done, and
+     returns false if a call moves nothing. The iovecs are used up along
+     the way. */
+  template <class Transfer>
+  static bool transfer_all( std::vector<iovec> & iovecs, Transfer && transfer )
+  {
+    size_t next = 0;
+
+    while ( next < iovecs.size() ) {
+      const int count = std::min( iovecs.size() - next, static_cast<size_t>( IOV_MAX ) );
+      size_t moved = transfer( &iovecs.at( next ), count );
+
+      if ( moved == 0 ) {
+        return false;
+      }
+
+      /* skip what was moved, which may end partway through an iovec */
+      while ( moved > 0 ) {
+        iovec & vec = iovecs.at( next );
+        if ( moved >= vec.iov_len ) {
+          moved -= vec.iov_len;
+          next++;
+        } else {
+          vec.iov_base = static_cast<uint8_t *>( vec.iov_base ) + moved;
+          vec.iov_len -= moved;
+          moved = 0;
+        }
+      }
+    }
+
+    return true;
+  }
+
 public:
   FileDescriptor( const int s_fd ) : fd_( s_fd ) {}
 
@@ -32,6 +71,14 @@ public:
     return file_info.st_size;
   }
 
+  /* in nanoseconds since the epoch */
+  uint64_t modification_time( void ) const
+  {
+    struct stat file_info;
+    SystemCall( "fstat", fstat( fd_, &file_info ) );
+    return uint64_t( file_info.st_mtim.tv_sec ) * 1000000000 + file_info.st_mtim.tv_nsec;
+  }
+
   const int & num( void ) const { return fd_; }
 
   bool eof() { return eof_; }
@@ -89,6 +136,35 @@ public:
     }
   }
 
+  /* writes out every iovec, using them up */
+  void writev( std::vector<iovec> & iovecs )
+  {
+    const bool written = transfer_all( iovecs, [&] ( const iovec * vecs, const int count ) {
+        return SystemCall( "writev", ::writev( fd_, vecs, count ) );
+      } );
+
+    if ( not written ) {
+      throw internal_error( "writev", "returned 0" );
+    }
+  }
+
+  /* Fills every iovec, using them up, with before_read called ahead of
+     each read. Returns false, and sets eof(), if the file ends first. */
+  bool readv( std::vector<iovec> & iovecs,
+              const std::function<void( void )> & before_read = [] () {} )
+  {
+    const bool filled = transfer_all( iovecs, [&] ( const iovec * vecs, const int count ) {
+        before_read();
+        return SystemCall( "readv", ::readv( fd_, vecs, count ) );
+      } );
+
+    if ( not filled ) {
+      eof_ = true;
+    }
+
+    return filled;
+  }
+
   std::string pread( const off_t offset, const size_t length )
   {
     static const size_t BUFFER_SIZE = 1048576;
@@ -152,4 +228,18 @@ public:
   }
 };
 
+/* Writes contents to a temporary file beside filename, then renames it
+   into place, so a reader never sees a half-written file. */
+inline void replace_file( const std::string & filename, const std::string & contents )
+{
+  const std::string temp_filename = filename + ".tmp";
+  {
+    FileDescriptor fd( SystemCall( temp_filename,
+                                   open( temp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                                         S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) );
+    fd.write( contents );
+  }
+  SystemCall( "rename", rename( temp_filename.c_str(), filename.c_str() ) );
+}
+
 #endif /* FILE_DESCRIPTOR_HH */
@@ -1,10 +1,30 @@
+#include <unistd.h>
 #include <stdexcept>
 
 #include "ivf.hh"
 #include "file.hh"
+#include "file_descriptor.hh"
 
 using namespace std;
 
+static const string index_magic = "IVFIDX";
+static const uint64_t index_entry_len = 8 + 4;
+
+void IVF::check_header( const Chunk & header )
+{
+  if ( header( 0, 4 ).to_string() != "DKIF" ) {
+    throw Invalid( "missing IVF file header" );
+  }
+
+  if ( header( 4, 2 ).le16() != 0 ) {
+    throw Unsupported( "not an IVF version 0 file" );
+  }
+
+  if ( header( 6, 2 ).le16() != supported_header_len ) {
+    throw Unsupported( "unsupported IVF header length" );
+  }
+}
+
 IVF::IVF( const string & filename )
 try :
   file_( filename ),
@@ -15,44 +35,229 @@ try :
     frame_rate_( header_( 16, 4 ).le32() ),
     time_scale_( header_( 20, 4 ).le32() ),
     frame_count_( header_( 24, 4 ).le32() ),
-    frame_index_()
+    frame_index_(),
+    frame_index_mutex_()
       {
-	if ( header_( 0, 4 ).to_string() != "DKIF" ) {
-	  throw Invalid( "missing IVF file header" );
-	}
-
-	if ( header_( 4, 2 ).le16() != 0 ) {
-	  throw Unsupported( "not an IVF version 0 file" );
-	}
-
-	if ( header_( 6, 2 ).le16() != supported_header_len ) {
-	  throw Unsupported( "unsupported IVF header length" );
-	}
-
-	/* build the index */
-	frame_index_.reserve( frame_count_ );
+	check_header( header_ );
 
-	uint64_t position = supported_header_len;
-	for ( uint32_t i = 0; i < frame_count_; i++ ) {
-	  Chunk frame_header = file_( position, frame_header_len );
-	  const uint32_t frame_len = frame_header.le32();
-
-	  frame_index_.emplace_back( position + frame_header_len, frame_len );
-	  position += frame_header_len + frame_len;
-	}
+	/* the frame headers are otherwise walked only as far as frames are asked for */
+	load_index( index_filename( filename ) );
       }
 catch ( const out_of_range & e )
   {
     throw Invalid( "IVF file truncated" );
   }
 
+string IVF::index_filename( const string & filename )
+{
+  return filename + ".index";
+}
+
+/* magic, IVF file size and modification time, frame count, then offset
+   and length of each frame */
+bool IVF::load_index( const string & index_filename )
+{
+  if ( access( index_filename.c_str(), R_OK ) != 0 ) {
+    return false;
+  }
+
+  const File index( index_filename );
+  const uint64_t entries_offset = index_magic.size() + 1 + 8 + 8 + 4;
+
+  /* an index of some other file, or of an older version of this one, is ignored */
+  if ( index.chunk().size() != entries_offset + uint64_t( frame_count_ ) * index_entry_len
+       or index( 0, index_magic.size() + 1 ).to_string() != index_magic + '\0'
+       or index( index_magic.size() + 1, 8 ).le64() != file_.chunk().size()
+       or index( index_magic.size() + 9, 8 ).le64() != file_.modification_time()
+       or index( index_magic.size() + 17, 4 ).le32() != frame_count_ ) {
+    return false;
+  }
+
+  vector< pair<uint64_t, uint32_t> > frame_index;
+  frame_index.reserve( frame_count_ );
+
+  /* the frames must follow one another to the end of the file, as a scan would find them */
+  uint64_t position = supported_header_len;
+  for ( uint32_t i = 0; i < frame_count_; i++ ) {
+    const Chunk entry = index( entries_offset + uint64_t( i ) * index_entry_len, index_entry_len );
+    const uint64_t offset = entry( 0, 8 ).le64();
+    const uint32_t length = entry( 8, 4 ).le32();
+
+    if ( offset != position + frame_header_len ) {
+      return false;
+    }
+
+    position = offset + length;
+    frame_index.emplace_back( offset, length );
+  }
+
+  if ( position != file_.chunk().size() ) {
+    return false;
+  }
+
+  frame_index_ = move( frame_index );
+  return true;
+}
+
+void IVF::write_index( const string & index_filename ) const
+{
+  string out = index_magic;
+  out.push_back( 0 );
+
+  const uint64_t file_size = htole64( file_.chunk().size() );
+  out.append( reinterpret_cast<const char *>( &file_size ), sizeof( file_size ) );
+  const uint64_t modification_time = htole64( file_.modification_time() );
+  out.append( reinterpret_cast<const char *>( &modification_time ), sizeof( modification_time ) );
+  const uint32_t frame_count = htole32( frame_count_ );
+  out.append( reinterpret_cast<const char *>( &frame_count ), sizeof( frame_count ) );
+
+  for ( uint32_t i = 0; i < frame_count_; i++ ) {
+    const pair<uint64_t, uint32_t> location = frame_location( i );
+    const uint64_t offset = htole64( location.first );
+    const uint32_t length = htole32( location.second );
+    out.append( reinterpret_cast<const char *>( &offset ), sizeof( offset ) );
+    out.append( reinterpret_cast<const char *>( &length ), sizeof( length ) );
+  }
+
+  replace_file( index_filename, out );
+}
+
 Chunk IVF::frame( const uint32_t & index ) const
 {
   const auto & entry = frame_location( index );
-  return file_( entry.first, entry.second );
+
+  try {
+    return file_( entry.first, entry.second );
+  } catch ( const out_of_range & e ) {
+    throw Invalid( "IVF file truncated" );
+  }
 }
 
 pair<uint64_t, uint32_t> IVF::frame_location( const uint32_t & index ) const
 {
+  if ( index >= frame_count_ ) {
+    throw out_of_range( "frame index past end of file" );
+  }
+
+  lock_guard<mutex> lock( frame_index_mutex_ );
+
+  try {
+    while ( frame_index_.size() <= index ) {
+      const uint64_t position = frame_index_.empty()
+        ? supported_header_len
+        : frame_index_.back().first + frame_index_.back().second;
+
+      const uint32_t frame_len = file_( position, frame_header_len ).le32();
+      frame_index_.emplace_back( position + frame_header_len, frame_len );
+    }
+  } catch ( const out_of_range & e ) {
+    throw Invalid( "IVF file truncated" );
+  }
+
   return frame_index_.at( index );
 }
+
+IVFStream::IVFStream( FileDescriptor && fd )
+  : fd_( move( fd ) ),
+    fourcc_(),
+    width_(),
+    height_(),
+    frame_rate_(),
+    time_scale_(),
+    buffer_( IVF::supported_header_len ),
+    frame_size_( 0 ),
+    frame_read_( false ),
+    eof_( false ),
+    frame_position_( 0 ),
+    position_( 0 )
+{
+  if ( read( buffer_.data(), IVF::supported_header_len ) != IVF::supported_header_len ) {
+    throw Invalid( "IVF file truncated" );
+  }
+
+  const Chunk header( buffer_ );
+  IVF::check_header( header );
+
+  fourcc_ = header( 8, 4 ).to_string();
+  width_ = header( 12, 2 ).le16();
+  height_ = header( 14, 2 ).le16();
+  frame_rate_ = header( 16, 4 ).le32();
+  time_scale_ = header( 20, 4 ).le32();
+
+  /* the header's frame count is not trusted; a stream ends where its data does */
+}
+
+size_t IVFStream::read( uint8_t * destination, const size_t length )
+{
+  size_t total = 0;
+
+  while ( total < length ) {
+    const ssize_t bytes_read = SystemCall( "read", ::read( fd_.num(), destination + total, length - total ) );
+    if ( bytes_read == 0 ) {
+      break;
+    }
+    total += bytes_read;
+  }
+
+  position_ += total;
+  return total;
+}
+
+void IVFStream::read_frame( void )
+{
+  if ( frame_read_ or eof_ ) {
+    return;
+  }
+
+  uint8_t frame_header[ IVF::frame_header_len ];
+  const size_t header_read = read( frame_header, IVF::frame_header_len );
+
+  if ( header_read == 0 ) {
+    eof_ = true;
+    return;
+  } else if ( header_read != IVF::frame_header_len ) {
+    throw Invalid( "IVF file truncated" );
+  }
+
+  frame_size_ = Chunk( frame_header, IVF::frame_header_len ).le32();
+  frame_position_ = position_;
+
+  if ( buffer_.size() < frame_size_ ) {
+    buffer_.resize( frame_size_ );
+  }
+
+  if ( read( buffer_.data(), frame_size_ ) != frame_size_ ) {
+    throw Invalid( "IVF file truncated" );
+  }
+
+  frame_read_ = true;
+}
+
+bool IVFStream::eof( void )
+{
+  read_frame();
+  return eof_;
+}
+
+Chunk IVFStream::frame( void )
+{
+  read_frame();
+
+  if ( eof_ ) {
+    throw out_of_range( "read past end of IVF stream" );
+  }
+
+  return Chunk( buffer_.data(), frame_size_ );
+}
+
+pair<uint64_t, uint32_t> IVFStream::frame_location( void )
+{
+  frame();
+  return make_pair( frame_position_, frame_size_ );
+}
+
+void IVFStream::pop( void )
+{
+  read_frame();
+  frame_read_ = false;
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <mutex>
 
 #include "file.hh"
 
@@ -17,12 +18,21 @@ private:
   uint16_t width_, height_;
   uint32_t frame_rate_, time_scale_, frame_count_;
 
-  std::vector< std::pair<uint64_t, uint32_t> > frame_index_;
+  /* filled in as far as the frames asked for, or all at once from the
+     sidecar index if there is an up-to-date one; guarded by
+     frame_index_mutex_, as several threads may read the same file */
+  mutable std::vector< std::pair<uint64_t, uint32_t> > frame_index_;
+  mutable std::mutex frame_index_mutex_;
+
+  bool load_index( const std::string & index_filename );
 
 public:
   static constexpr int supported_header_len = 32;
   static constexpr int frame_header_len = 12;
 
+  /* checks the 32-byte file header, throwing if it is not one we can read */
+  static void check_header( const Chunk & header );
+
   IVF( const std::string & filename );
 
   const std::string & fourcc( void ) const { return fourcc_; }
@@ -32,8 +42,65 @@ public:
   uint32_t time_scale( void ) const { return time_scale_; }
   uint32_t frame_count( void ) const { return frame_count_; }
 
+  /* of the file, which together tell a rewritten file from the original */
+  uint64_t size( void ) const { return file_.chunk().size(); }
+  uint64_t modification_time( void ) const { return file_.modification_time(); }
+
   Chunk frame( const uint32_t & index ) const;
   std::pair<uint64_t, uint32_t> frame_location( const uint32_t & index ) const;
+
+  /* where the index of an IVF file is kept, next to it */
+  static std::string index_filename( const std::string & filename );
+
+  /* index every frame and save the index, for later opens to load */
+  void write_index( const std::string & index_filename ) const;
+};
+
+/* Reads an IVF file front to back from a file descriptor, such as a
+   pipe, one frame at a time. Only the frame being read is held, in a
+   buffer reused from frame to frame. */
+class IVFStream
+{
+private:
+  FileDescriptor fd_;
+
+  std::string fourcc_;
+  uint16_t width_, height_;
+  uint32_t frame_rate_, time_scale_;
+
+  std::vector<uint8_t> buffer_;
+  uint32_t frame_size_;
+  bool frame_read_;
+  bool eof_;
+
+  /* offset in the file of the frame read (after its frame header) */
+  uint64_t frame_position_;
+  uint64_t position_;
+
+  /* bytes read, which is fewer than length only at the end of the file */
+  size_t read( uint8_t * destination, const size_t length );
+
+  void read_frame( void );
+
+public:
+  IVFStream( FileDescriptor && fd );
+
+  const std::string & fourcc( void ) const { return fourcc_; }
+  uint16_t width( void ) const { return width_; }
+  uint16_t height( void ) const { return height_; }
+  uint32_t frame_rate( void ) const { return frame_rate_; }
+  uint32_t time_scale( void ) const { return time_scale_; }
+
+  /* reads ahead to the next frame's header if need be */
+  bool eof( void );
+
+  /* the next frame, without moving past it; valid until the next call
+     to frame() after a pop() */
+  Chunk frame( void );
+  std::pair<uint64_t, uint32_t> frame_location( void );
+
+  /* move on to the frame after */
+  void pop( void );
 };
 
 #endif /* IVF_HH */
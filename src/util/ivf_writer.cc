@@ -1,6 +1,8 @@
 #include <cstring>
+#include <cstdlib>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 
@@ -10,6 +12,9 @@
 
 using namespace std;
 
+/* O_DIRECT writes must start and end on a multiple of this */
+static const size_t direct_alignment = 4096;
+
 template <typename T> void zero( T & x ) { memset( &x, 0, sizeof( x ) ); }
 
 static void memcpy_le16( uint8_t * dest, const uint16_t val )
@@ -24,23 +29,47 @@ static void memcpy_le32( uint8_t * dest, const uint32_t val )
   memcpy( dest, &swizzled, sizeof( swizzled ) );
 }
 
+static void write_all( const int fd, const uint8_t * data, size_t length )
+{
+  while ( length > 0 ) {
+    const size_t written = SystemCall( "write", ::write( fd, data, length ) );
+    if ( written == 0 ) {
+      throw internal_error( "write", "returned 0" );
+    }
+    data += written;
+    length -= written;
+  }
+}
+
+void IVFWriter::FreeDeleter::operator() ( uint8_t * x ) const
+{
+  free( x );
+}
+
 IVFWriter::IVFWriter( FileDescriptor && fd,
 		      const string & fourcc,
 		      const uint16_t width,
 		      const uint16_t height,
 		      const uint32_t frame_rate,
-		      const uint32_t time_scale )
+		      const uint32_t time_scale,
+		      const Mode mode,
+		      const Durability durability )
   : fd_( move( fd ) ),
     file_size_( 0 ),
-    frame_count_( 0 )
+    frame_count_( 0 ),
+    mode_( mode ),
+    durability_( durability )
 {
   if ( fourcc.size() != 4 ) {
     throw internal_error( "IVF", "FourCC must be four bytes long" );
   }
 
+  if ( mode_ == Mode::Immediate and durability_ != Durability::None ) {
+    throw internal_error( "IVF", "durability policies need a batched writer" );
+  }
+
   /* build the header */
-  SafeArray<uint8_t, IVF::supported_header_len> new_header;
-  zero( new_header );
+  vector<uint8_t> new_header( IVF::supported_header_len, 0 );
 
   memcpy( &new_header.at( 0 ), "DKIF", 4 );
   /* skip version number (= 0) */
@@ -50,17 +79,48 @@ IVFWriter::IVFWriter( FileDescriptor && fd,
   memcpy_le16( &new_header.at( 14 ), height );
   memcpy_le32( &new_header.at( 16 ), frame_rate );
   memcpy_le32( &new_header.at( 20 ), time_scale );
+  /* the frame count (= 0) is filled in by append_frame() or close() */
+
+  if ( mode_ == Mode::Batched ) {
+    if ( durability_ == Durability::Direct ) {
+      const int flags = SystemCall( "fcntl", fcntl( fd_.num(), F_GETFL ) );
+      SystemCall( "fcntl", fcntl( fd_.num(), F_SETFL, flags | O_DIRECT ) );
+
+      void * buffer = nullptr;
+      if ( posix_memalign( &buffer, direct_alignment, batch_size ) != 0 ) {
+        throw bad_alloc();
+      }
+      direct_buffer_.reset( static_cast<uint8_t *>( buffer ) );
+    }
+
+    queue( move( new_header ) );
+    writer_ = thread( [this] () { write_batches(); } );
+    return;
+  }
 
   /* write the header */
-  fd_.write( Chunk( &new_header.at( 0 ), new_header.size() ) );
+  fd_.write( Chunk( new_header ) );
   file_size_ += new_header.size();
 
   /* verify the new file size */
   assert( fd_.size() == file_size_ );
 }
 
+IVFWriter::~IVFWriter()
+{
+  try {
+    close();
+  } catch ( const exception & e ) {
+    print_exception( "IVFWriter", e );
+  }
+}
+
 size_t IVFWriter::append_frame( const Chunk & chunk )
 {
+  if ( mode_ == Mode::Batched ) {
+    return append_frame( vector<uint8_t>( chunk.buffer(), chunk.buffer() + chunk.size() ) );
+  }
+
   /* map the header into memory */
   MMap_Region header_in_mem( IVF::supported_header_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_.num() );
   uint8_t * mutable_header_ptr = header_in_mem.addr();
@@ -102,15 +162,163 @@ size_t IVFWriter::append_frame( const Chunk & chunk )
   return written_offset;
 }
 
+size_t IVFWriter::append_frame( vector<uint8_t> && frame )
+{
+  if ( mode_ == Mode::Immediate ) {
+    return append_frame( Chunk( frame ) );
+  }
+
+  /* XXX does not include presentation timestamp */
+  vector<uint8_t> new_header( IVF::frame_header_len, 0 );
+  memcpy_le32( &new_header.at( 0 ), frame.size() );
+
+  queue( move( new_header ) );
+  const size_t written_offset = file_size_;
+  queue( move( frame ) );
+  frame_count_++;
+
+  if ( pending_size_ >= batch_size ) {
+    submit_pending();
+  }
+
+  return written_offset;
+}
+
+void IVFWriter::queue( vector<uint8_t> && bytes )
+{
+  file_size_ += bytes.size();
+  pending_size_ += bytes.size();
+  pending_.push_back( move( bytes ) );
+}
+
+void IVFWriter::submit_pending( void )
+{
+  if ( not queued_batches_.push( move( pending_ ) ) ) {
+    /* the writer failed */
+    queued_batches_.rethrow_failure();
+  }
+
+  pending_.clear();
+  pending_size_ = 0;
+}
+
+void IVFWriter::write_batches( void )
+{
+  while ( true ) {
+    Optional<Batch> batch = queued_batches_.pop();
+
+    if ( not batch.initialized() ) {
+      return;
+    }
+
+    try {
+      write_batch( batch.get() );
+    } catch ( ... ) {
+      queued_batches_.fail( current_exception() );
+      return;
+    }
+  }
+}
+
+void IVFWriter::write_batch( Batch & batch )
+{
+  if ( durability_ == Durability::Direct ) {
+    for ( const vector<uint8_t> & bytes : batch ) {
+      write_direct( bytes );
+    }
+
+    /* write the whole blocks, keeping the rest for the next batch */
+    const size_t aligned = direct_buffer_used_ - direct_buffer_used_ % direct_alignment;
+    write_all( fd_.num(), direct_buffer_.get(), aligned );
+    memmove( direct_buffer_.get(), direct_buffer_.get() + aligned, direct_buffer_used_ - aligned );
+    direct_buffer_used_ -= aligned;
+
+    return;
+  }
+
+  vector<iovec> iovecs;
+  iovecs.reserve( batch.size() );
+  for ( vector<uint8_t> & bytes : batch ) {
+    if ( not bytes.empty() ) {
+      iovecs.push_back( { bytes.data(), bytes.size() } );
+    }
+  }
+
+  fd_.writev( iovecs );
+
+  if ( durability_ == Durability::DataSync ) {
+    SystemCall( "fdatasync", fdatasync( fd_.num() ) );
+  }
+}
+
+void IVFWriter::write_direct( const vector<uint8_t> & bytes )
+{
+  size_t copied = 0;
+
+  while ( copied < bytes.size() ) {
+    const size_t length = min( bytes.size() - copied, batch_size - direct_buffer_used_ );
+    memcpy( direct_buffer_.get() + direct_buffer_used_, bytes.data() + copied, length );
+    direct_buffer_used_ += length;
+    copied += length;
+
+    if ( direct_buffer_used_ == batch_size ) {
+      write_all( fd_.num(), direct_buffer_.get(), batch_size );
+      direct_buffer_used_ = 0;
+    }
+  }
+}
+
+void IVFWriter::close( void )
+{
+  if ( not writer_.joinable() ) {
+    return;
+  }
+
+  /* dropped if the writer has failed, which is rethrown after the join */
+  if ( not pending_.empty() ) {
+    queued_batches_.push( move( pending_ ) );
+    pending_.clear();
+    pending_size_ = 0;
+  }
+  queued_batches_.finish();
+
+  writer_.join();
+
+  queued_batches_.rethrow_failure();
+
+  if ( durability_ == Durability::Direct ) {
+    /* the last block is partial, so it goes through the page cache */
+    const int flags = SystemCall( "fcntl", fcntl( fd_.num(), F_GETFL ) );
+    SystemCall( "fcntl", fcntl( fd_.num(), F_SETFL, flags & ~O_DIRECT ) );
+    write_all( fd_.num(), direct_buffer_.get(), direct_buffer_used_ );
+    direct_buffer_used_ = 0;
+  }
+
+  /* now that the frame count is known */
+  uint8_t frame_count[ 4 ];
+  memcpy_le32( frame_count, frame_count_ );
+  if ( SystemCall( "pwrite", pwrite( fd_.num(), frame_count, sizeof( frame_count ), 24 ) ) != sizeof( frame_count ) ) {
+    throw internal_error( "pwrite", "short write" );
+  }
+
+  if ( durability_ != Durability::None ) {
+    SystemCall( "fdatasync", fdatasync( fd_.num() ) );
+  }
+
+  assert( fd_.size() == file_size_ );
+}
+
 IVFWriter::IVFWriter( const string & filename,
 		      const string & fourcc,
 		      const uint16_t width,
 		      const uint16_t height,
 		      const uint32_t frame_rate,
-		      const uint32_t time_scale )
+		      const uint32_t time_scale,
+		      const Mode mode,
+		      const Durability durability )
   : IVFWriter( SystemCall( filename,
 			   open( filename.c_str(),
 				 O_RDWR | O_CREAT | O_TRUNC,
 				 S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH ) ),
-	       fourcc, width, height, frame_rate, time_scale )
+	       fourcc, width, height, frame_rate, time_scale, mode, durability )
 {}
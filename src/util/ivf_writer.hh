@@ -1,31 +1,101 @@
 #ifndef IVF_WRITER_HH
 #define IVF_WRITER_HH
 
+#include <vector>
+#include <memory>
+#include <thread>
+
 #include "ivf.hh"
+#include "bounded_queue.hh"
 
 class IVFWriter
 {
+public:
+  enum class Mode
+  {
+    Immediate,  /* each frame written, and counted in the header, before append_frame() returns */
+    Batched     /* frames written in batches by a background thread; the header is finished by close() */
+  };
+
+  /* what a batched writer does to get the data onto storage */
+  enum class Durability
+  {
+    None,       /* leave it to the page cache */
+    DataSync,   /* fdatasync after every batch */
+    Direct      /* write through O_DIRECT, bypassing the page cache */
+  };
+
+  /* a batch is handed to the writer once it holds this many bytes */
+  static constexpr size_t batch_size = 4 << 20;
+
+  /* append_frame() waits for the writer only with this many batches queued */
+  static constexpr size_t max_queued_batches = 4;
+
 private:
+  /* bytes to write, in order: the file header, then frame headers and frames */
+  typedef std::vector<std::vector<uint8_t>> Batch;
+
   FileDescriptor fd_;
   uint64_t file_size_;
   uint32_t frame_count_;
 
+  Mode mode_;
+  Durability durability_;
+
+  Batch pending_ {};
+  size_t pending_size_ { 0 };
+
+  BoundedQueue<Batch> queued_batches_ { max_queued_batches };
+
+  /* for Durability::Direct, data is staged here until it fills whole blocks */
+  struct FreeDeleter { void operator() ( uint8_t * x ) const; };
+  std::unique_ptr<uint8_t, FreeDeleter> direct_buffer_ {};
+  size_t direct_buffer_used_ { 0 };
+
+  std::thread writer_ {};
+
+  void queue( std::vector<uint8_t> && bytes );
+  void submit_pending( void );
+
+  void write_batches( void );
+  void write_batch( Batch & batch );
+  void write_direct( const std::vector<uint8_t> & bytes );
+
 public:
   IVFWriter( const std::string & filename,
 	     const std::string & fourcc,
 	     const uint16_t width,
 	     const uint16_t height,
 	     const uint32_t frame_rate,
-	     const uint32_t time_scale );
+	     const uint32_t time_scale,
+	     const Mode mode = Mode::Immediate,
+	     const Durability durability = Durability::None );
 
   IVFWriter( FileDescriptor && fd,
 	     const std::string & fourcc,
 	     const uint16_t width,
 	     const uint16_t height,
 	     const uint32_t frame_rate,
-	     const uint32_t time_scale );
+	     const uint32_t time_scale,
+	     const Mode mode = Mode::Immediate,
+	     const Durability durability = Durability::None );
 
+  /* closes the file, if close() has not; errors can only be printed */
+  ~IVFWriter();
+
+  /* returns the offset of the frame in the file */
   size_t append_frame( const Chunk & chunk );
+
+  /* the same, but a batched writer keeps the frame rather than a copy */
+  size_t append_frame( std::vector<uint8_t> && frame );
+
+  /* Waits for everything appended to be written, then writes the frame
+     count into the header. Throws if any write failed. */
+  void close( void );
+
+  /* forbid copying or moving */
+  IVFWriter( const IVFWriter & other ) = delete;
+  IVFWriter & operator=( const IVFWriter & other ) = delete;
 };
 
 #endif /* IVF_WRITER_HH */
@@ -1,4 +1,3 @@
-#include <boost/functional/hash.hpp>
 #include <cstdio>
 
 #include "exception.hh"
@@ -7,6 +6,8 @@
 
 using namespace std;
 
+constexpr unsigned int BaseRaster::border;
+
 BaseRaster::BaseRaster( const unsigned int display_width, const unsigned int display_height,
   const unsigned int width, const unsigned int height)
   : display_width_( display_width ), display_height_( display_height ),
@@ -21,20 +22,9 @@ BaseRaster::BaseRaster( const unsigned int display_width, const unsigned int dis
   }
 }
 
-size_t BaseRaster::raw_hash( void ) const
+double BaseRaster::quality( const BaseRaster & other, ThreadPool * const thread_pool ) const
 {
-  size_t hash_val = 0;
-
-  boost::hash_range( hash_val, Y_.begin(), Y_.end() );
-  boost::hash_range( hash_val, U_.begin(), U_.end() );
-  boost::hash_range( hash_val, V_.begin(), V_.end() );
-
-  return hash_val;
-}
-
-double BaseRaster::quality( const BaseRaster & other ) const
-{
-  return ssim( Y(), other.Y() );
+  return plane_quality( Y(), other.Y(), display_width(), display_height(), thread_pool ).ssim;
 }
 
 bool BaseRaster::operator==( const BaseRaster & other ) const
@@ -54,6 +44,13 @@ void BaseRaster::copy_from( const BaseRaster & other )
   V_.copy_from( other.V_ );
 }
 
+void BaseRaster::extend_borders( void )
+{
+  Y_.extend_border();
+  U_.extend_border();
+  V_.extend_border();
+}
+
 vector<Chunk> BaseRaster::display_rectangle_as_planar() const
 {
   vector<Chunk> ret;
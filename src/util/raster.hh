@@ -7,11 +7,15 @@
 #include "safe_array.hh"
 #include "chunk.hh"
 
+class ThreadPool;
+
 /* For an array of pixels, context and separate construction not necessary */
 template<>
 template< typename... Targs >
 TwoDStorage<uint8_t>::TwoDStorage( const unsigned int width, const unsigned int height, Targs&&... Fargs )
-  : width_( width ), height_( height ), storage_( width * height, Fargs... )
+  : width_( width ), height_( height ),
+    border_( 0 ), stride_( width ), origin_( 0 ),
+    storage_( width * height, Fargs... )
 {
   assert( width > 0 );
   assert( height > 0 );
@@ -19,15 +23,18 @@ TwoDStorage<uint8_t>::TwoDStorage( const unsigned int width, const unsigned int
 
 class BaseRaster
 {
+public:
+  /* pixels allocated around each plane, so that motion vectors pointing
+     up to this far outside the picture can be served without clamping */
+  static constexpr unsigned int border = 32;
+
 protected:
   unsigned int display_width_, display_height_;
   unsigned int width_, height_;
 
-  TwoD< uint8_t > Y_ { width_, height_ },
-    U_ { width_ / 2, height_ / 2 },
-    V_ { width_ / 2, height_ / 2 };
-
-  size_t raw_hash( void ) const;
+  TwoD< uint8_t > Y_ { width_, height_, TwoDBorder { border } },
+    U_ { width_ / 2, height_ / 2, TwoDBorder { border } },
+    V_ { width_ / 2, height_ / 2, TwoDBorder { border } };
 
 public:
   BaseRaster( const unsigned int display_width, const unsigned int display_height,
@@ -49,14 +56,17 @@ public:
   unsigned int chroma_display_width() const { return (1 + display_width_) / 2; }
   unsigned int chroma_display_height() const { return (1 + display_height_) / 2; }
 
-  // SSIM as determined by libx264
-  double quality( const BaseRaster & other ) const;
+  /* luma SSIM over the displayed picture; raster_quality() in ssim.hh has all three planes */
+  double quality( const BaseRaster & other, ThreadPool * const thread_pool = nullptr ) const;
 
   bool operator==( const BaseRaster & other ) const;
   bool operator!=( const BaseRaster & other ) const;
 
   void copy_from( const BaseRaster & other );
 
+  /* fill each plane's border from its edge pixels, once the picture is final */
+  void extend_borders( void );
+
   std::vector<Chunk> display_rectangle_as_planar() const;
   void dump( FILE * file ) const; /* only used for debugging */
 };
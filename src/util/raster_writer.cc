@@ -0,0 +1,82 @@
+#include <fcntl.h>
+
+#include "raster_writer.hh"
+
+using namespace std;
+
+static const char frame_header[] = "FRAME\n";
+
+RasterWriter::RasterWriter( FileDescriptor && fd, const Format format,
+                            const uint32_t fps_numerator, const uint32_t fps_denominator )
+  : fd_( move( fd ) ), format_( format ),
+    fps_numerator_( fps_numerator ), fps_denominator_( fps_denominator )
+{}
+
+RasterWriter::RasterWriter( const string & filename, const Format format,
+                            const uint32_t fps_numerator, const uint32_t fps_denominator )
+  : RasterWriter( SystemCall( filename,
+                              open( filename.c_str(),
+                                    O_WRONLY | O_CREAT | O_TRUNC,
+                                    S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH ) ),
+                  format, fps_numerator, fps_denominator )
+{}
+
+RasterWriter::Format RasterWriter::format_for( const string & filename )
+{
+  const string extension = ".y4m";
+
+  if ( filename.size() >= extension.size()
+       and filename.compare( filename.size() - extension.size(), extension.size(), extension ) == 0 ) {
+    return Format::YUV4MPEG;
+  }
+
+  return Format::Raw;
+}
+
+void RasterWriter::add( const uint8_t * data, const size_t length )
+{
+  /* extend the last iovec if this picks up where it left off */
+  if ( not iovecs_.empty() ) {
+    iovec & last = iovecs_.back();
+    if ( static_cast<uint8_t *>( last.iov_base ) + last.iov_len == data ) {
+      last.iov_len += length;
+      return;
+    }
+  }
+
+  iovecs_.push_back( { const_cast<uint8_t *>( data ), length } );
+}
+
+void RasterWriter::add_plane( const TwoD<uint8_t> & plane, const unsigned int width, const unsigned int height )
+{
+  for ( unsigned int row = 0; row < height; row++ ) {
+    add( &plane.at( 0, row ), width );
+  }
+}
+
+void RasterWriter::flush( void )
+{
+  fd_.writev( iovecs_ );
+  iovecs_.clear();
+}
+
+void RasterWriter::write( const BaseRaster & raster )
+{
+  if ( format_ == Format::YUV4MPEG ) {
+    if ( stream_header_.empty() ) {
+      stream_header_ = "YUV4MPEG2 W" + to_string( raster.display_width() )
+        + " H" + to_string( raster.display_height() )
+        + " F" + to_string( fps_numerator_ ) + ":" + to_string( fps_denominator_ )
+        + " Ip A1:1 C420jpeg\n";
+      add( reinterpret_cast<const uint8_t *>( stream_header_.data() ), stream_header_.size() );
+    }
+
+    add( reinterpret_cast<const uint8_t *>( frame_header ), sizeof( frame_header ) - 1 );
+  }
+
+  add_plane( raster.Y(), raster.display_width(), raster.display_height() );
+  add_plane( raster.U(), raster.chroma_display_width(), raster.chroma_display_height() );
+  add_plane( raster.V(), raster.chroma_display_width(), raster.chroma_display_height() );
+
+  flush();
+}
@@ -0,0 +1,51 @@
+#ifndef RASTER_WRITER_HH
+#define RASTER_WRITER_HH
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include "raster.hh"
+#include "file_descriptor.hh"
+
+/* Writes the displayed part of each raster to a file descriptor, as raw
+   planar YUV 4:2:0 or as YUV4MPEG2. Rows are written straight out of
+   the planes with writev, a run of rows that are contiguous in memory
+   as a single iovec, rather than copied through a stdio buffer. */
+class RasterWriter
+{
+public:
+  enum class Format { Raw, YUV4MPEG };
+
+private:
+  FileDescriptor fd_;
+  Format format_;
+
+  /* for the YUV4MPEG2 header, written ahead of the first frame */
+  uint32_t fps_numerator_, fps_denominator_;
+  std::string stream_header_ {};
+
+  std::vector<iovec> iovecs_ {};
+
+  void add( const uint8_t * data, const size_t length );
+  void add_plane( const TwoD<uint8_t> & plane, const unsigned int width, const unsigned int height );
+
+  /* write out every iovec, however many calls that takes */
+  void flush( void );
+
+public:
+  RasterWriter( FileDescriptor && fd, const Format format,
+                const uint32_t fps_numerator = 30, const uint32_t fps_denominator = 1 );
+
+  /* creates or truncates the file */
+  RasterWriter( const std::string & filename, const Format format,
+                const uint32_t fps_numerator = 30, const uint32_t fps_denominator = 1 );
+
+  /* YUV4MPEG for names ending in .y4m, raw otherwise */
+  static Format format_for( const std::string & filename );
+
+  void write( const BaseRaster & raster );
+};
+
+#endif /* RASTER_WRITER_HH */
@@ -0,0 +1,114 @@
+#ifndef ROW_HASH_HH
+#define ROW_HASH_HH
+
+#include <cstdint>
+#include <cstring>
+
+/* 64-bit hash of a sequence of rows of bytes, built on the xxHash64
+   round. Rows are consumed eight bytes at a time, dealt in turn to four
+   independent lanes that carry over from one row to the next, so even
+   the 8-pixel rows of a chroma block keep all four lanes busy. The
+   result depends on where the row boundaries fall as well as on the
+   bytes. */
+class RowHash
+{
+private:
+  static constexpr uint64_t prime1 = 11400714785074694791ULL;
+  static constexpr uint64_t prime2 = 14029467366897019727ULL;
+  static constexpr uint64_t prime3 = 1609587929392839161ULL;
+  static constexpr uint64_t prime4 = 9650029242287828579ULL;
+  static constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+  uint64_t lanes_[ 4 ];
+  unsigned int next_lane_;
+  uint64_t tail_;
+  uint64_t length_;
+
+  static uint64_t rotate_left( const uint64_t x, const unsigned int bits )
+  {
+    return ( x << bits ) | ( x >> ( 64 - bits ) );
+  }
+
+  static uint64_t read64( const uint8_t * data )
+  {
+    uint64_t ret;
+    std::memcpy( &ret, data, sizeof( ret ) );
+    return ret;
+  }
+
+  static uint64_t round( uint64_t accumulator, const uint64_t input )
+  {
+    accumulator += input * prime2;
+    accumulator = rotate_left( accumulator, 31 );
+    return accumulator * prime1;
+  }
+
+  static uint64_t merge( uint64_t hash, const uint64_t lane )
+  {
+    hash ^= round( 0, lane );
+    return hash * prime1 + prime4;
+  }
+
+public:
+  RowHash( const uint64_t seed = 0 )
+    : lanes_ { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 },
+      next_lane_( 0 ),
+      tail_( seed + prime5 ),
+      length_( 0 )
+  {}
+
+  void update( const uint8_t * data, const size_t length )
+  {
+    const uint8_t * const end = data + length;
+
+    /* finish the stripe the previous row left open */
+    for ( ; next_lane_ != 0 and data + 8 <= end; data += 8 ) {
+      lanes_[ next_lane_ ] = round( lanes_[ next_lane_ ], read64( data ) );
+      next_lane_ = ( next_lane_ + 1 ) % 4;
+    }
+
+    for ( ; data + 32 <= end; data += 32 ) {
+      lanes_[ 0 ] = round( lanes_[ 0 ], read64( data ) );
+      lanes_[ 1 ] = round( lanes_[ 1 ], read64( data + 8 ) );
+      lanes_[ 2 ] = round( lanes_[ 2 ], read64( data + 16 ) );
+      lanes_[ 3 ] = round( lanes_[ 3 ], read64( data + 24 ) );
+    }
+
+    for ( ; data + 8 <= end; data += 8 ) {
+      lanes_[ next_lane_ ] = round( lanes_[ next_lane_ ], read64( data ) );
+      next_lane_ = ( next_lane_ + 1 ) % 4;
+    }
+
+    for ( ; data < end; data++ ) {
+      tail_ ^= *data * prime5;
+      tail_ = rotate_left( tail_, 11 ) * prime1;
+    }
+
+    /* mark the end of the row */
+    tail_ = rotate_left( tail_ ^ length, 23 ) * prime2 + prime3;
+    length_ += length;
+  }
+
+  uint64_t digest( void ) const
+  {
+    uint64_t hash = rotate_left( lanes_[ 0 ], 1 ) + rotate_left( lanes_[ 1 ], 7 )
+      + rotate_left( lanes_[ 2 ], 12 ) + rotate_left( lanes_[ 3 ], 18 );
+
+    for ( const uint64_t lane : lanes_ ) {
+      hash = merge( hash, lane );
+    }
+
+    hash = merge( hash, tail_ ) + length_;
+
+    /* final avalanche */
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+  }
+};
+
+#endif /* ROW_HASH_HH */
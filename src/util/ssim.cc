@@ -1,50 +1,383 @@
-#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <atomic>
 #include <vector>
-#include <x264.h>
+#include <algorithm>
 
+#include "config.h"
 #include "ssim.hh"
+#include "raster.hh"
+#include "thread_pool.hh"
+#include "exception.hh"
 
-struct x264_pixel_function_t
+#ifdef HAVE_SSE2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/* sums over one 4x4 block of pixels a and b: a, b, a² + b², and a b */
+struct BlockSums
 {
-  // 158 is the number of pointers in this internal x264 struct
-  // this is obviously a bit fragile since x264 could add more
-  void * ptrs[ 158 ];
+  int32_t s1, s2, ss, s12;
 };
 
-// These are internal libx264 instructions so they aren't included in x264.h
-extern "C"
+/* the sums of each of the blocks in a row, 4 pixels high and 4 * blocks wide */
+typedef void BlockRowSums( const uint8_t * a, const unsigned int stride_a,
+                           const uint8_t * b, const unsigned int stride_b,
+                           const unsigned int blocks, BlockSums * sums );
+
+static void block_row_sums_c( const uint8_t * a, const unsigned int stride_a,
+                              const uint8_t * b, const unsigned int stride_b,
+                              const unsigned int blocks, BlockSums * sums )
+{
+  for ( unsigned int block = 0; block < blocks; block++ ) {
+    BlockSums & s = sums[ block ];
+    s = { 0, 0, 0, 0 };
+
+    for ( unsigned int row = 0; row < 4; row++ ) {
+      for ( unsigned int column = 4 * block; column < 4 * block + 4; column++ ) {
+        const int32_t pa = a[ row * stride_a + column ], pb = b[ row * stride_b + column ];
+        s.s1 += pa;
+        s.s2 += pb;
+        s.ss += pa * pa + pb * pb;
+        s.s12 += pa * pb;
+      }
+    }
+  }
+}
+
+#ifdef HAVE_SSE2
+/* two blocks at a time */
+static void block_row_sums_sse2( const uint8_t * a, const unsigned int stride_a,
+                                 const uint8_t * b, const unsigned int stride_b,
+                                 const unsigned int blocks, BlockSums * sums )
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16( 1 );
+
+  unsigned int block = 0;
+  for ( ; block + 2 <= blocks; block += 2 ) {
+    __m128i sum_a = zero, sum_b = zero, sum_squares = zero, sum_products = zero;
+
+    for ( unsigned int row = 0; row < 4; row++ ) {
+      const __m128i pa = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i *>( a + row * stride_a + 4 * block ) ), zero );
+      const __m128i pb = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i *>( b + row * stride_b + 4 * block ) ), zero );
+
+      sum_a = _mm_add_epi16( sum_a, pa );
+      sum_b = _mm_add_epi16( sum_b, pb );
+      sum_squares = _mm_add_epi32( sum_squares, _mm_add_epi32( _mm_madd_epi16( pa, pa ), _mm_madd_epi16( pb, pb ) ) );
+      sum_products = _mm_add_epi32( sum_products, _mm_madd_epi16( pa, pb ) );
+    }
+
+    /* each 32-bit lane holds two columns; fold them so lanes 0 and 2 hold the blocks */
+    __m128i s1 = _mm_madd_epi16( sum_a, ones ), s2 = _mm_madd_epi16( sum_b, ones );
+    s1 = _mm_add_epi32( s1, _mm_srli_epi64( s1, 32 ) );
+    s2 = _mm_add_epi32( s2, _mm_srli_epi64( s2, 32 ) );
+    sum_squares = _mm_add_epi32( sum_squares, _mm_srli_epi64( sum_squares, 32 ) );
+    sum_products = _mm_add_epi32( sum_products, _mm_srli_epi64( sum_products, 32 ) );
+
+    /* then transpose into two BlockSums */
+    const __m128i s1_s2 = _mm_unpacklo_epi32( s1, s2 ), s1_s2_next = _mm_unpackhi_epi32( s1, s2 );
+    const __m128i ss_s12 = _mm_unpacklo_epi32( sum_squares, sum_products ),
+      ss_s12_next = _mm_unpackhi_epi32( sum_squares, sum_products );
+
+    _mm_storeu_si128( reinterpret_cast<__m128i *>( sums + block ), _mm_unpacklo_epi64( s1_s2, ss_s12 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i *>( sums + block + 1 ), _mm_unpacklo_epi64( s1_s2_next, ss_s12_next ) );
+  }
+
+  block_row_sums_c( a + 4 * block, stride_a, b + 4 * block, stride_b, blocks - block, sums + block );
+}
+#endif
+
+#ifdef ARCH_X86_64
+/* four blocks at a time, the same way as the SSE2 version in each 128-bit half */
+__attribute__(( target( "avx2" ) ))
+static void block_row_sums_avx2( const uint8_t * a, const unsigned int stride_a,
+                                 const uint8_t * b, const unsigned int stride_b,
+                                 const unsigned int blocks, BlockSums * sums )
 {
-  float x264_pixel_ssim_wxh( const x264_pixel_function_t * func, const uint8_t *pix1,
-                             uintptr_t stride1, const uint8_t *pix2, uintptr_t stride2,
-                             int width, int height, void *buf, int *cnt );
+  const __m256i ones = _mm256_set1_epi16( 1 );
+
+  unsigned int block = 0;
+  for ( ; block + 4 <= blocks; block += 4 ) {
+    __m256i sum_a = _mm256_setzero_si256(), sum_b = sum_a, sum_squares = sum_a, sum_products = sum_a;
+
+    for ( unsigned int row = 0; row < 4; row++ ) {
+      const __m256i pa = _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i *>( a + row * stride_a + 4 * block ) ) );
+      const __m256i pb = _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i *>( b + row * stride_b + 4 * block ) ) );
+
+      sum_a = _mm256_add_epi16( sum_a, pa );
+      sum_b = _mm256_add_epi16( sum_b, pb );
+      sum_squares = _mm256_add_epi32( sum_squares, _mm256_add_epi32( _mm256_madd_epi16( pa, pa ), _mm256_madd_epi16( pb, pb ) ) );
+      sum_products = _mm256_add_epi32( sum_products, _mm256_madd_epi16( pa, pb ) );
+    }
+
+    __m256i s1 = _mm256_madd_epi16( sum_a, ones ), s2 = _mm256_madd_epi16( sum_b, ones );
+    s1 = _mm256_add_epi32( s1, _mm256_srli_epi64( s1, 32 ) );
+    s2 = _mm256_add_epi32( s2, _mm256_srli_epi64( s2, 32 ) );
+    sum_squares = _mm256_add_epi32( sum_squares, _mm256_srli_epi64( sum_squares, 32 ) );
+    sum_products = _mm256_add_epi32( sum_products, _mm256_srli_epi64( sum_products, 32 ) );
+
+    const __m256i s1_s2 = _mm256_unpacklo_epi32( s1, s2 ), s1_s2_next = _mm256_unpackhi_epi32( s1, s2 );
+    const __m256i ss_s12 = _mm256_unpacklo_epi32( sum_squares, sum_products ),
+      ss_s12_next = _mm256_unpackhi_epi32( sum_squares, sum_products );
 
-  void x264_pixel_init( int cpu, x264_pixel_function_t *pixf );
+    /* blocks 0 and 2, then 1 and 3 */
+    const __m256i even = _mm256_unpacklo_epi64( s1_s2, ss_s12 ), odd = _mm256_unpacklo_epi64( s1_s2_next, ss_s12_next );
 
-  uint32_t x264_cpu_detect( void );
+    _mm256_storeu_si256( reinterpret_cast<__m256i *>( sums + block ), _mm256_permute2x128_si256( even, odd, 0x20 ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i *>( sums + block + 2 ), _mm256_permute2x128_si256( even, odd, 0x31 ) );
+  }
+
+  block_row_sums_sse2( a + 4 * block, stride_a, b + 4 * block, stride_b, blocks - block, sums + block );
 }
+#endif
 
-x264_pixel_function_t init_pixel_function( void )
+static BlockRowSums * select_block_row_sums( void )
 {
-  x264_pixel_function_t pix_func;
-  x264_pixel_init( x264_cpu_detect(), &pix_func );
+#ifdef ARCH_X86_64
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return block_row_sums_avx2;
+  }
+#endif
 
-  return pix_func;
+#ifdef HAVE_SSE2
+  return block_row_sums_sse2;
+#else
+  return block_row_sums_c;
+#endif
 }
 
-x264_pixel_function_t x264_funcs = init_pixel_function();
+static BlockRowSums * const block_row_sums = select_block_row_sums();
+
+/* x264's ssim_end1, from the sums over an 8x8 window (scaled by 64 to stay in integers) */
+static float window_ssim( const BlockSums & s )
+{
+  static const int c1 = .01 * .01 * 255 * 255 * 64 + .5;
+  static const int c2 = .03 * .03 * 255 * 255 * 64 * 63 + .5;
+
+  const int64_t s1 = s.s1, s2 = s.s2;
+  const int64_t vars = int64_t( s.ss ) * 64 - s1 * s1 - s2 * s2;
+  const int64_t covar = int64_t( s.s12 ) * 64 - s1 * s2;
+
+  return float( 2 * s1 * s2 + c1 ) * float( 2 * covar + c2 )
+    / ( float( s1 * s1 + s2 * s2 + c1 ) * float( vars + c2 ) );
+}
+
+static uint64_t squared_error( const uint8_t * a, const uint8_t * b, const unsigned int length )
+{
+  uint64_t sum = 0;
+  for ( unsigned int i = 0; i < length; i++ ) {
+    const int difference = a[ i ] - b[ i ];
+    sum += difference * difference;
+  }
+  return sum;
+}
+
+/* A horizontal stripe of a plane: the windows whose top block row is in
+   [first_row, end_row), and the squared error of the pixels in those
+   block rows (and, for the last stripe, of every row below). */
+struct Stripe
+{
+  const TwoD<uint8_t> * a, * b;
+  unsigned int width, height;
+  unsigned int first_row, end_row;
+  bool last;
+
+  double ssim_sum;
+  uint64_t squared_error;
+
+  void measure( void );
+};
+
+void Stripe::measure( void )
+{
+  const unsigned int blocks_wide = width / 4, blocks_high = height / 4;
+  const unsigned int stride_a = a->stride(), stride_b = b->stride();
+
+  vector<BlockSums> above( blocks_wide ), below( blocks_wide );
+
+  ssim_sum = 0;
+  squared_error = 0;
+
+  auto sum_row = [&] ( const unsigned int block_row, vector<BlockSums> & sums ) {
+    block_row_sums( &a->at( 0, 4 * block_row ), stride_a, &b->at( 0, 4 * block_row ), stride_b,
+                    blocks_wide, sums.data() );
+
+    if ( block_row < end_row or last ) {
+      for ( const BlockSums & s : sums ) {
+        squared_error += s.ss - 2 * s.s12;
+      }
+
+      /* and the columns right of the last block */
+      if ( width % 4 ) {
+        for ( unsigned int row = 4 * block_row; row < 4 * block_row + 4; row++ ) {
+          squared_error += ::squared_error( &a->at( 4 * blocks_wide, row ), &b->at( 4 * blocks_wide, row ),
+                                            width % 4 );
+        }
+      }
+    }
+  };
+
+  sum_row( first_row, above );
+
+  for ( unsigned int block_row = first_row; block_row < end_row; block_row++ ) {
+    sum_row( block_row + 1, below );
+
+    for ( unsigned int x = 0; x + 1 < blocks_wide; x++ ) {
+      ssim_sum += window_ssim( { above[ x ].s1 + above[ x + 1 ].s1 + below[ x ].s1 + below[ x + 1 ].s1,
+                                 above[ x ].s2 + above[ x + 1 ].s2 + below[ x ].s2 + below[ x + 1 ].s2,
+                                 above[ x ].ss + above[ x + 1 ].ss + below[ x ].ss + below[ x + 1 ].ss,
+                                 above[ x ].s12 + above[ x + 1 ].s12 + below[ x ].s12 + below[ x + 1 ].s12 } );
+    }
+
+    swap( above, below );
+  }
+
+  if ( last ) {
+    for ( unsigned int row = 4 * blocks_high; row < height; row++ ) {
+      squared_error += ::squared_error( &a->at( 0, row ), &b->at( 0, row ), width );
+    }
+  }
+}
+
+/* splits the plane's rows of windows into up to count stripes */
+static void add_stripes( vector<Stripe> & stripes,
+                         const TwoD<uint8_t> & a, const TwoD<uint8_t> & b,
+                         const unsigned int width, const unsigned int height,
+                         const unsigned int count )
+{
+  if ( width > a.width() or height > a.height() or width > b.width() or height > b.height() ) {
+    throw Invalid( "SSIM region is larger than the plane" );
+  }
+
+  if ( width < 8 or height < 8 ) {
+    throw Invalid( "SSIM needs at least an 8x8 region" );
+  }
+
+  const unsigned int window_rows = height / 4 - 1;
+  const unsigned int pieces = min( count, window_rows );
+
+  for ( unsigned int i = 0; i < pieces; i++ ) {
+    stripes.push_back( { &a, &b, width, height,
+                         window_rows * i / pieces, window_rows * ( i + 1 ) / pieces, i + 1 == pieces,
+                         0, 0 } );
+  }
+}
+
+static void measure_stripes( vector<Stripe> & stripes, ThreadPool * const thread_pool )
+{
+  if ( thread_pool == nullptr or thread_pool->concurrency() == 1 ) {
+    for ( Stripe & stripe : stripes ) {
+      stripe.measure();
+    }
+    return;
+  }
+
+  /* each thread takes the next stripe until there are none left */
+  atomic<size_t> next_stripe { 0 };
+  thread_pool->run( [&] ( const unsigned int ) {
+      for ( size_t i = next_stripe++; i < stripes.size(); i = next_stripe++ ) {
+        stripes[ i ].measure();
+      }
+    } );
+}
+
+static PlaneQuality add_up( const vector<Stripe> & stripes, const size_t first, const size_t end )
+{
+  const Stripe & stripe = stripes.at( first );
+  const uint64_t windows = uint64_t( stripe.width / 4 - 1 ) * ( stripe.height / 4 - 1 );
+
+  PlaneQuality quality;
+  double ssim_sum = 0;
+  for ( size_t i = first; i < end; i++ ) {
+    ssim_sum += stripes.at( i ).ssim_sum;
+    quality.squared_error += stripes.at( i ).squared_error;
+  }
+
+  quality.ssim = ssim_sum / windows;
+  quality.samples = uint64_t( stripe.width ) * stripe.height;
+  return quality;
+}
+
+static double psnr( const uint64_t squared_error, const uint64_t samples )
+{
+  if ( squared_error == 0 ) {
+    return numeric_limits<double>::infinity();
+  }
+
+  return 10 * log10( 255.0 * 255.0 * samples / squared_error );
+}
+
+double PlaneQuality::psnr( void ) const
+{
+  return ::psnr( squared_error, samples );
+}
+
+double RasterQuality::ssim( void ) const
+{
+  return ( Y.ssim * Y.samples + U.ssim * U.samples + V.ssim * V.samples )
+    / ( Y.samples + U.samples + V.samples );
+}
+
+double RasterQuality::psnr( void ) const
+{
+  return ::psnr( Y.squared_error + U.squared_error + V.squared_error,
+                 Y.samples + U.samples + V.samples );
+}
+
+PlaneQuality plane_quality( const TwoD<uint8_t> & image, const TwoD<uint8_t> & other_image,
+                            const unsigned int width, const unsigned int height,
+                            ThreadPool * const thread_pool )
+{
+  vector<Stripe> stripes;
+  add_stripes( stripes, image, other_image, width, height,
+               thread_pool ? 2 * thread_pool->concurrency() : 1 );
+  measure_stripes( stripes, thread_pool );
+  return add_up( stripes, 0, stripes.size() );
+}
 
 double ssim( const TwoD<uint8_t> & image, const TwoD<uint8_t> & other_image )
 {
-   int count;
-   std::vector<uint8_t> tmp_buffer;
-   // Buffer size calculation taken from x264
-   tmp_buffer.resize( 8 * ( image.width() / 4 + 3 ) * sizeof( int ) );
+  return plane_quality( image, other_image, image.width(), image.height() ).ssim;
+}
+
+RasterQuality raster_quality( const BaseRaster & raster, const BaseRaster & other,
+                              ThreadPool * const thread_pool )
+{
+  if ( raster.display_width() != other.display_width()
+       or raster.display_height() != other.display_height() ) {
+    throw Invalid( "cannot compare rasters of different sizes" );
+  }
+
+  /* pictures smaller than a window are measured with some of the padding */
+  auto region = [] ( const unsigned int display, const unsigned int plane ) {
+    return max( display, min( 8u, plane ) );
+  };
+
+  const unsigned int luma_width = region( raster.display_width(), raster.Y().width() );
+  const unsigned int luma_height = region( raster.display_height(), raster.Y().height() );
+  const unsigned int chroma_width = region( raster.chroma_display_width(), raster.U().width() );
+  const unsigned int chroma_height = region( raster.chroma_display_height(), raster.U().height() );
+
+  /* the chroma planes get half as many stripes, being a quarter the size */
+  const unsigned int threads = thread_pool ? thread_pool->concurrency() : 1;
+  const unsigned int luma_stripes = threads == 1 ? 1 : 2 * threads;
+
+  vector<Stripe> stripes;
+  add_stripes( stripes, raster.Y(), other.Y(), luma_width, luma_height, luma_stripes );
+  const size_t u_begin = stripes.size();
+  add_stripes( stripes, raster.U(), other.U(), chroma_width, chroma_height, threads );
+  const size_t v_begin = stripes.size();
+  add_stripes( stripes, raster.V(), other.V(), chroma_width, chroma_height, threads );
 
-   // No padding so stride = width
-   double ssim = x264_pixel_ssim_wxh( &x264_funcs, &image.at( 0, 0 ), image.width(),
-                                      &other_image.at( 0, 0 ), other_image.width(),
-                                      image.width(), image.height(),
-                                      tmp_buffer.data(), &count );
+  measure_stripes( stripes, thread_pool );
 
-   return ssim / count;
+  RasterQuality quality;
+  quality.Y = add_up( stripes, 0, u_begin );
+  quality.U = add_up( stripes, u_begin, v_begin );
+  quality.V = add_up( stripes, v_begin, stripes.size() );
+  return quality;
 }
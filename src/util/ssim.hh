@@ -1,3 +1,47 @@
+#ifndef SSIM_HH
+#define SSIM_HH
+
+#include <cstdint>
+
 #include "2d.hh"
 
+class BaseRaster;
+class ThreadPool;
+
+/* how closely one plane matches another */
+struct PlaneQuality
+{
+  double ssim { 1 };
+  uint64_t squared_error { 0 };
+  uint64_t samples { 0 };
+
+  /* in dB; infinite for identical planes */
+  double psnr( void ) const;
+};
+
+struct RasterQuality
+{
+  PlaneQuality Y {}, U {}, V {};
+
+  /* each plane weighted by its samples, i.e. ( 4 Y + U + V ) / 6 */
+  double ssim( void ) const;
+
+  /* from the squared error over all three planes */
+  double psnr( void ) const;
+};
+
+/* SSIM as x264 computes it: the mean over 8x8 windows, 4 pixels apart,
+   of the top-left width x height pixels. SIMD where the CPU has it. */
+PlaneQuality plane_quality( const TwoD<uint8_t> & image, const TwoD<uint8_t> & other_image,
+                            const unsigned int width, const unsigned int height,
+                            ThreadPool * const thread_pool = nullptr );
+
+/* of the whole planes */
 double ssim( const TwoD<uint8_t> & image, const TwoD<uint8_t> & other_image );
+
+/* All three planes over the displayed picture, in horizontal stripes
+   shared among the pool's threads (null means the calling thread only). */
+RasterQuality raster_quality( const BaseRaster & raster, const BaseRaster & other,
+                              ThreadPool * const thread_pool = nullptr );
+
+#endif /* SSIM_HH */
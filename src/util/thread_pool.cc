@@ -0,0 +1,114 @@
+#include <cassert>
+
+#include "thread_pool.hh"
+
+using namespace std;
+
+ThreadPool::ThreadPool( const unsigned int concurrency )
+{
+  for ( unsigned int i = 1; i < concurrency; i++ ) {
+    workers_.emplace_back( [this, i] () { work( i ); } );
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    lock_guard<mutex> lock( mutex_ );
+    shutting_down_ = true;
+  }
+  job_available_.notify_all();
+
+  for ( auto & worker : workers_ ) {
+    worker.join();
+  }
+}
+
+unsigned int ThreadPool::default_concurrency( void )
+{
+  const unsigned int hardware = thread::hardware_concurrency();
+  return hardware ? hardware : 1;
+}
+
+void ThreadPool::work( const unsigned int thread_index )
+{
+  uint64_t last_job_number = 0;
+
+  while ( true ) {
+    const Job * job;
+
+    {
+      unique_lock<mutex> lock( mutex_ );
+      job_available_.wait( lock, [&] () { return shutting_down_ or job_number_ != last_job_number; } );
+
+      if ( shutting_down_ ) {
+        return;
+      }
+
+      last_job_number = job_number_;
+      job = job_;
+    }
+
+    exception_ptr error;
+    try {
+      (*job)( thread_index );
+    } catch ( ... ) {
+      error = current_exception();
+    }
+
+    {
+      lock_guard<mutex> lock( mutex_ );
+      if ( error and not error_ ) {
+        error_ = error;
+      }
+
+      assert( busy_workers_ > 0 );
+      if ( --busy_workers_ == 0 ) {
+        job_finished_.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::run( const Job & job )
+{
+  /* one job at a time, even if several callers share the pool */
+  lock_guard<mutex> run_lock( run_mutex_ );
+
+  if ( workers_.empty() ) {
+    job( 0 );
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock( mutex_ );
+    job_ = &job;
+    error_ = nullptr;
+    busy_workers_ = workers_.size();
+    job_number_++;
+  }
+  job_available_.notify_all();
+
+  exception_ptr error;
+  try {
+    job( 0 );
+  } catch ( ... ) {
+    error = current_exception();
+  }
+
+  {
+    unique_lock<mutex> lock( mutex_ );
+    job_finished_.wait( lock, [&] () { return busy_workers_ == 0; } );
+
+    if ( not error ) {
+      error = error_;
+    }
+
+    job_ = nullptr;
+    error_ = nullptr;
+  }
+
+  if ( error ) {
+    rethrow_exception( error );
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+/* fixed set of worker threads that run one job at a time */
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+class ThreadPool
+{
+public:
+  typedef std::function<void( const unsigned int thread_index )> Job;
+
+private:
+  std::mutex run_mutex_ {};
+
+  std::mutex mutex_ {};
+  std::condition_variable job_available_ {};
+  std::condition_variable job_finished_ {};
+
+  const Job * job_ { nullptr };
+  uint64_t job_number_ { 0 };
+  unsigned int busy_workers_ { 0 };
+  std::exception_ptr error_ {};
+  bool shutting_down_ { false };
+
+  std::vector<std::thread> workers_ {};
+
+  void work( const unsigned int thread_index );
+
+public:
+  /* concurrency counts the calling thread, so ThreadPool( 1 ) spawns nothing */
+  ThreadPool( const unsigned int concurrency );
+  ~ThreadPool();
+
+  unsigned int concurrency( void ) const { return workers_.size() + 1; }
+
+  /* Runs job( 0 ) ... job( concurrency() - 1 ) simultaneously, one per
+     thread, with the caller taking index 0. Every invocation is running
+     at the same time, so they may wait on one another. Returns when all
+     have finished and rethrows the first exception any of them threw. */
+  void run( const Job & job );
+
+  static unsigned int default_concurrency( void );
+
+  /* forbid copying or moving */
+  ThreadPool( const ThreadPool & other ) = delete;
+  ThreadPool & operator=( const ThreadPool & other ) = delete;
+};
+
+#endif /* THREAD_POOL_HH */